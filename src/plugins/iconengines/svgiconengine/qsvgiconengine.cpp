@@ -45,6 +45,7 @@
 #include "qsvgrenderer.h"
 #include "qpixmapcache.h"
 #include "qfileinfo.h"
+#include "qset.h"
 #include <qmimedatabase.h>
 #include <qmimetype.h>
 #include <QAtomicInt>
@@ -321,9 +322,12 @@ void QSvgIconEnginePrivate::addSvgClass(QIcon::Mode mode, QIcon::State state,
     int key = hashKey(mode, state);
     QMap<int, QStringList>::iterator it = svgClassMap->find(key);
     if (it != svgClassMap->end()) {
-        for (QString className : svgClass) {
-            if (!it.value().contains(className))
+        QSet<QString> known = it.value().toSet();
+        for (const QString &className : svgClass) {
+            if (!known.contains(className)) {
+                known.insert(className);
                 it.value().append(className);
+            }
         }
     } else {
         svgClassMap->insert(key, svgClass);
@@ -345,7 +349,9 @@ QPixmap QSvgIconEngine::pixmap(const QSize &size, QIcon::Mode mode,
             return pm;
     }
 
+    // Icons are rendered once per pixmap, animation ticks would be wasted.
     QSvgRenderer renderer;
+    renderer.setAnimationActive(false);
     const QIcon::Mode loadmode = d->loadDataForModeAndState(&renderer, size, mode, state);
     if (!renderer.isValid())
         return pm;
@@ -422,8 +428,9 @@ void QSvgIconEngine::addFile(const QString &fileName, const QSize & size,
 #else
          if (type == SvgFile) {
 #endif
-             QSvgRenderer renderer(abs);
-             if (renderer.isValid()) {
+             QSvgRenderer renderer;
+             renderer.setAnimationActive(false);
+             if (renderer.load(abs)) {
                  d->stepSerialNum();
                  d->addSvgClass(mode, state, renderer.xmlClassList());
                  if (d->isMultiSize) {
@@ -56,7 +56,7 @@ public:
     Q_DECLARE_PUBLIC(QGraphicsSvgItem)
 
     QGraphicsSvgItemPrivate()
-        : renderer(0), shared(false)
+        : renderer(0), shared(false), pausedWhileHidden(false)
     {
     }
 
@@ -69,6 +69,7 @@ public:
                          q, SLOT(_q_repaintItem()));
         q->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
         q->setMaximumCacheSize(QSize(1024, 768));
+        updateAnimationActive();
     }
 
     void _q_repaintItem()
@@ -90,9 +91,27 @@ public:
         }
     }
 
+    // Items that are hidden or not in a scene have nothing to repaint, so
+    // their own renderer stops animating until they are shown again.
+    void updateAnimationActive()
+    {
+        Q_Q(QGraphicsSvgItem);
+        if (shared)
+            return;
+        const bool shown = q->isVisible() && q->scene();
+        if (!shown && renderer->isAnimationActive()) {
+            pausedWhileHidden = true;
+            renderer->setAnimationActive(false);
+        } else if (shown && pausedWhileHidden) {
+            pausedWhileHidden = false;
+            renderer->setAnimationActive(true);
+        }
+    }
+
     QSvgRenderer *renderer;
     QRectF boundingRect;
     bool shared;
+    bool pausedWhileHidden;
     QString elemId;
 };
 
@@ -264,6 +283,17 @@ int QGraphicsSvgItem::type() const
     return Type;
 }
 
+/*!
+    \reimp
+*/
+QVariant QGraphicsSvgItem::itemChange(GraphicsItemChange change, const QVariant &value)
+{
+    Q_D(QGraphicsSvgItem);
+    if (change == ItemVisibleHasChanged || change == ItemSceneHasChanged)
+        d->updateAnimationActive();
+    return QGraphicsObject::itemChange(change, value);
+}
+
 /*!
   \property QGraphicsSvgItem::maximumCacheSize
   \since 4.6
@@ -354,6 +384,7 @@ void QGraphicsSvgItem::setSharedRenderer(QSvgRenderer *renderer)
 
     d->renderer = renderer;
     d->shared = true;
+    d->pausedWhileHidden = false;
 
     d->updateDefaultSize();
 
@@ -85,6 +85,9 @@ public:
     enum { Type = 13 };
     int type() const override;
 
+protected:
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
 private:
     Q_DISABLE_COPY(QGraphicsSvgItem)
     Q_DECLARE_PRIVATE_D(QGraphicsItem::d_ptr.data(), QGraphicsSvgItem)
@@ -41,6 +41,8 @@
 
 #ifndef QT_NO_SVGGENERATOR
 
+#include "qsvgnumberformat_p.h"
+
 #include "qpainterpath.h"
 
 #include "private/qpaintengine_p.h"
@@ -54,6 +56,7 @@
 #include "qmath.h"
 #include "qbitmap.h"
 #include "qcryptographichash.h"
+#include "qset.h"
 
 #include "qdebug.h"
 
@@ -96,7 +99,12 @@ public:
         clipPathEnabled = false;
         textCoordEnabled = false;
         trimEmptyGroupEnabled = false;
+        streamingEnabled = false;
+        compactGroupsEnabled = false;
+        stateStream = nullptr;
         dataPrefix = "";
+        imageFormat = QByteArrayLiteral("png");
+        imageQuality = -1;
 
         attributes.document_title = QLatin1String("Qt SVG Document");
         attributes.document_description = QLatin1String("Generated with Qt");
@@ -107,6 +115,7 @@ public:
 
         afterFirstUpdate = false;
         discardStashStream = false;
+        attributedGroups = 0;
         numGradients = 0;
         numClipPaths = 0;
     }
@@ -120,13 +129,24 @@ public:
     bool clipPathEnabled;
     bool textCoordEnabled;
     bool trimEmptyGroupEnabled;
+    bool streamingEnabled;
+    bool compactGroupsEnabled;
+    QScopedPointer<QTextStream> deviceStream; // streaming mode only
+    QTextStream *stateStream; // set while updateState() collects the group attributes
+    QString stateAttributes; // attributes of the currently open state group
     QString dataPrefix;
+    QByteArray imageFormat;
+    int imageQuality;
+    QSvgNumberFormatter numberFormatter;
+    QByteArray numberBuffer; // scratch space for path data and coordinate lists
 
     QString header;
     QString defs;
     QString body;
     bool    afterFirstUpdate;
     bool    discardStashStream;
+    QVector<bool> userGroups; // open beginGroup() groups, true if they set attributes
+    int attributedGroups; // how many of them set attributes
     QString stashContent;
 
     QBrush brush;
@@ -144,27 +164,36 @@ public:
 
     QString currentGradientName;
     int numGradients;
+    QHash<QVector<qreal>, QString> savedGradients; // structural key -> id
 
     bool getClipPathId(QString &id) {
-        QRectF rect = clipPath.boundingRect();
-        QVector<qreal> hashKey = {rect.x(), rect.y(), rect.width(), rect.height()};
-        auto &vector = clipPathCache[hashKey];
-        for (const auto p : vector) {
-            if (clipPath == p.first) {
-                id = p.second;
-                return false;
-            }
+        QVector<qreal> hashKey;
+        hashKey.reserve(1 + 3 * clipPath.elementCount());
+        hashKey << clipPath.fillRule();
+        for (int i = 0; i < clipPath.elementCount(); ++i) {
+            const QPainterPath::Element &e = clipPath.elementAt(i);
+            hashKey << e.type << e.x << e.y;
+        }
+        QString &cachedId = clipPathCache[hashKey];
+        if (!cachedId.isEmpty()) {
+            id = cachedId;
+            return false;
         }
         id = QString::fromLatin1("clipPath%1_%2").arg(dataPrefix).arg(++numClipPaths);
-        vector.push_back(qMakePair(clipPath, id));
+        cachedId = id;
         return true;
     }
 
     int numClipPaths;
-    QHash<QVector<qreal>, QVector<QPair<QPainterPath, QString>>> clipPathCache;
+    QHash<QVector<qreal>, QString> clipPathCache; // fill rule and elements -> id
 
-    QStringList savedPatternBrushes;
-    QStringList savedPatternMasks;
+    QSet<QString> savedPatternBrushes;
+    QSet<QString> savedPatternMasks;
+    // {cacheKey, x, y, width, height} -> id of the texture pattern
+    QHash<QVector<qint64>, QString> texturePatternIds;
+
+    QHash<QByteArray, QString> savedImages; // content hash -> id
+    QHash<qint64, QString> savedImageKeys; // QImage::cacheKey() -> id
 
     struct _attributes {
         QString document_title;
@@ -190,6 +219,95 @@ static inline QPaintEngine::PaintEngineFeatures svgEngineFeatures()
 
 Q_GUI_EXPORT QImage qt_imageForBrush(int brushStyle, bool invert);
 
+// Axis aligned rectangles, as produced by QPainter::setClipRect(), with or
+// without the closing line back to the start.
+static bool isRectPath(const QPainterPath &path, QRectF *rect)
+{
+    const int count = path.elementCount();
+    if (count != 4 && count != 5)
+        return false;
+    if (path.elementAt(0).type != QPainterPath::MoveToElement)
+        return false;
+    for (int i = 1; i < count; ++i) {
+        if (path.elementAt(i).type != QPainterPath::LineToElement)
+            return false;
+    }
+    const QPointF p0 = path.elementAt(0);
+    if (count == 5 && QPointF(path.elementAt(4)) != p0)
+        return false;
+
+    const QPointF p1 = path.elementAt(1);
+    const QPointF p2 = path.elementAt(2);
+    const QPointF p3 = path.elementAt(3);
+    const bool horizontalFirst = p0.y() == p1.y() && p1.x() == p2.x()
+            && p2.y() == p3.y() && p3.x() == p0.x();
+    const bool verticalFirst = p0.x() == p1.x() && p1.y() == p2.y()
+            && p2.x() == p3.x() && p3.y() == p0.y();
+    if (!horizontalFirst && !verticalFirst)
+        return false;
+
+    *rect = QRectF(p0, p2).normalized();
+    return true;
+}
+
+static bool isOpaqueImage(const QImage &image)
+{
+    if (!image.hasAlphaChannel())
+        return true;
+
+    switch (image.format()) {
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        for (int y = 0; y < image.height(); ++y) {
+            const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                if (qAlpha(line[x]) != 255)
+                    return false;
+            }
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Everything that ends up in a gradient definition, so that equal keys
+// produce identical <linearGradient>/<radialGradient> elements.
+static QVector<qreal> gradientKey(const QGradient *g)
+{
+    QVector<qreal> key;
+    key << g->type() << g->spread() << g->coordinateMode() << g->interpolationMode();
+    if (g->type() == QGradient::LinearGradient) {
+        const QLinearGradient *grad = static_cast<const QLinearGradient *>(g);
+        key << grad->start().x() << grad->start().y()
+            << grad->finalStop().x() << grad->finalStop().y();
+    } else if (g->type() == QGradient::RadialGradient) {
+        const QRadialGradient *grad = static_cast<const QRadialGradient *>(g);
+        key << grad->center().x() << grad->center().y() << grad->radius()
+            << grad->focalPoint().x() << grad->focalPoint().y();
+    }
+    const QGradientStops stops = g->stops();
+    for (const QGradientStop &stop : stops) {
+        const QRgba64 c = stop.second.rgba64();
+        key << stop.first << qreal((quint32(c.red()) << 16) | c.green())
+            << qreal((quint32(c.blue()) << 16) | c.alpha());
+    }
+    return key;
+}
+
+static QByteArray imageContentHash(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    const int header[] = { image.width(), image.height(), int(image.format()) };
+    hash.addData(reinterpret_cast<const char *>(header), sizeof(header));
+    const int bytesPerLine = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+        hash.addData(reinterpret_cast<const char *>(image.constScanLine(y)), bytesPerLine);
+    const QVector<QRgb> colorTable = image.colorTable();
+    hash.addData(reinterpret_cast<const char *>(colorTable.constData()), colorTable.size() * int(sizeof(QRgb)));
+    return hash.result();
+}
+
 class QSvgPaintEngine : public QPaintEngine
 {
     Q_DECLARE_PRIVATE(QSvgPaintEngine)
@@ -270,6 +388,36 @@ public:
         d_func()->trimEmptyGroupEnabled = enable;
     }
 
+    bool streamingEnabled() { return d_func()->streamingEnabled; }
+    void setStreamingEnabled(bool enable) {
+        Q_ASSERT(!isActive());
+        d_func()->streamingEnabled = enable;
+    }
+
+    QByteArray imageFormat() { return d_func()->imageFormat; }
+    void setImageFormat(const QByteArray &format) {
+        Q_ASSERT(!isActive());
+        d_func()->imageFormat = format.toLower();
+    }
+
+    int imageQuality() { return d_func()->imageQuality; }
+    void setImageQuality(int quality) {
+        Q_ASSERT(!isActive());
+        d_func()->imageQuality = quality;
+    }
+
+    bool compactGroupsEnabled() { return d_func()->compactGroupsEnabled; }
+    void setCompactGroupsEnabled(bool enable) {
+        Q_ASSERT(!isActive());
+        d_func()->compactGroupsEnabled = enable;
+    }
+
+    int coordinatePrecision() { return d_func()->numberFormatter.precision(); }
+    void setCoordinatePrecision(int precision) {
+        Q_ASSERT(!isActive());
+        d_func()->numberFormatter.setPrecision(precision);
+    }
+
     QString dataPrefix() { return d_func()->dataPrefix; }
     void setDataPrefix(const QString prefix) {
         Q_ASSERT(!isActive());
@@ -284,6 +432,11 @@ public:
             *d->stream << "</g>\n\n";
             d->afterFirstUpdate = false;
         }
+        d->stateAttributes.clear();
+        const bool attributed = attrs && !attrs->isEmpty();
+        d->userGroups.append(attributed);
+        if (attributed)
+            ++d->attributedGroups;
         *d->stream << "<g ";
         if (attrs)
         {
@@ -293,6 +446,7 @@ public:
             }
         }
         *d->stream << '>' << endl;
+        flushStreamingContent();
     }
 
     void endGroup()
@@ -303,8 +457,12 @@ public:
             *d->stream << "</g>\n\n";
             d->afterFirstUpdate = false;
         }
+        d->stateAttributes.clear();
+        if (!d->userGroups.isEmpty() && d->userGroups.takeLast())
+            --d->attributedGroups;
 
         *d->stream << "</g>" << endl;
+        flushStreamingContent();
     }
 
     QString savePatternMask(Qt::BrushStyle style)
@@ -320,7 +478,7 @@ public:
             for (QRect r : reg)
                 str << rct.arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height()) << endl;
             str << QStringLiteral("</mask>") << endl << endl;
-            d_func()->savedPatternMasks.append(maskId);
+            d_func()->savedPatternMasks.insert(maskId);
         }
         return maskId;
     }
@@ -335,7 +493,7 @@ public:
             str << QString(QStringLiteral("<pattern id=\"%1\" %2 patternUnits=\"userSpaceOnUse\" >")).arg(patternId, geo) << endl;
             str << QString(QStringLiteral("<rect %1 stroke=\"none\" fill=\"%2\" mask=\"url(#%3);\" />")).arg(geo, color, maskId) << endl;
             str << QStringLiteral("</pattern>") << endl << endl;
-            d_func()->savedPatternBrushes.append(patternId);
+            d_func()->savedPatternBrushes.insert(patternId);
         }
         return patternId;
     }
@@ -363,15 +521,12 @@ public:
             y = (y - y / szImg.height() * szImg.height() + szImg.height()) % szImg.height();
         }
 
-        QByteArray data;
-        QBuffer buffer(&data);
-        buffer.open(QBuffer::ReadWrite);
-        img.save(&buffer, "PNG");
-        buffer.close();
+        const QVector<qint64> key = { img.cacheKey(), x, y, szImg.width(), szImg.height() };
+        QString &cachedId = d_func()->texturePatternIds[key];
+        if (!cachedId.isEmpty())
+            return cachedId;
 
-        QCryptographicHash hash(QCryptographicHash::Md5);
-        hash.addData(data.toBase64());
-        QString imgMd5 = hash.result().toHex();
+        QString imgMd5 = QString::fromLatin1(imageContentHash(img).toHex());
 
         QString patternId = QString(QStringLiteral("filltexturepattern%1_%2_%3_%4_%5"))
                                     .arg(imgMd5)
@@ -379,7 +534,14 @@ public:
                                     .arg(y)
                                     .arg(szImg.width())
                                     .arg(szImg.height());
+        cachedId = patternId;
         if (!d_func()->savedPatternBrushes.contains(patternId)) {
+            QByteArray data;
+            QBuffer buffer(&data);
+            buffer.open(QBuffer::ReadWrite);
+            img.save(&buffer, "PNG");
+            buffer.close();
+
             QTextStream str(&d_func()->defs, QIODevice::Append);
             str << QString(QStringLiteral("<pattern id=\"%1\" x=\"%2\" y=\"%3\" width=\"%4\" height=\"%5\" patternUnits=\"userSpaceOnUse\">"))
                             .arg(patternId)
@@ -395,14 +557,81 @@ public:
             str << QString(QStringLiteral("xlink:href=\"data:image/png;base64,")) << data.toBase64()
                 << QString(QStringLiteral("\"/>")) << endl;
             str << QStringLiteral("</pattern>") << endl << endl;
-            d_func()->savedPatternBrushes.append(patternId);
+            d_func()->savedPatternBrushes.insert(patternId);
         }
 
         return patternId;
     }
 
+    // Encodes \a image in the configured format; JPEG is only used for
+    // opaque images since it cannot carry an alpha channel.
+    QByteArray encodeImage(const QImage &image, QByteArray *mimeType)
+    {
+        Q_D(QSvgPaintEngine);
+        QByteArray format = d->imageFormat;
+        if (format == "jpg")
+            format = QByteArrayLiteral("jpeg");
+        if (format != "png" && (format != "jpeg" || !isOpaqueImage(image)))
+            format = QByteArrayLiteral("png");
+
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QBuffer::ReadWrite);
+        image.save(&buffer, format.constData(), d->imageQuality);
+        buffer.close();
+
+        *mimeType = "image/" + format;
+        return data;
+    }
+
+    // Emits \a image once into the defs and returns its id; later calls with
+    // the same image, or one with identical pixels, return the same id.
+    QString saveImage(const QImage &image, qint64 cacheKey)
+    {
+        Q_D(QSvgPaintEngine);
+        if (cacheKey) {
+            const auto it = d->savedImageKeys.constFind(cacheKey);
+            if (it != d->savedImageKeys.constEnd())
+                return it.value();
+        }
+
+        QString &id = d->savedImages[imageContentHash(image)];
+        if (id.isEmpty()) {
+            id = QString::fromLatin1("image%1_%2").arg(d->dataPrefix).arg(d->savedImages.size());
+
+            QByteArray mimeType;
+            const QByteArray data = encodeImage(image, &mimeType);
+            QTextStream str(&d->defs, QIODevice::Append);
+            str << "<image id=\"" << id << "\" "
+                   "width=\"" << image.width() << "\" "
+                   "height=\"" << image.height() << "\" "
+                   "preserveAspectRatio=\"none\" "
+                   "xlink:href=\"data:" << mimeType << ";base64," << data.toBase64() << "\" />" << endl;
+        }
+        if (cacheKey)
+            d->savedImageKeys.insert(cacheKey, id);
+        return id;
+    }
+
+    // Points currentGradientName at an earlier definition of an identical
+    // gradient; otherwise remembers \a key for the one about to be written.
+    bool reuseSavedGradient(const QGradient *g, QVector<qreal> *key)
+    {
+        Q_D(QSvgPaintEngine);
+        *key = gradientKey(g);
+        const auto it = d->savedGradients.constFind(*key);
+        if (it == d->savedGradients.constEnd())
+            return false;
+        d->currentGradientName = it.value();
+        return true;
+    }
+
     void saveLinearGradientBrush(const QGradient *g)
     {
+        QVector<qreal> key;
+        if (reuseSavedGradient(g, &key))
+            return;
+
         QTextStream str(&d_func()->defs, QIODevice::Append);
         const QLinearGradient *grad = static_cast<const QLinearGradient*>(g);
         str << QLatin1String("<linearGradient ");
@@ -417,9 +646,14 @@ public:
         str << QLatin1String("id=\"") << d_func()->generateGradientName(dataPrefix())<< QLatin1String("\">\n");
         saveGradientStops(str, g);
         str << QLatin1String("</linearGradient>") <<endl;
+        d_func()->savedGradients.insert(key, d_func()->currentGradientName);
     }
     void saveRadialGradientBrush(const QGradient *g)
     {
+        QVector<qreal> key;
+        if (reuseSavedGradient(g, &key))
+            return;
+
         QTextStream str(&d_func()->defs, QIODevice::Append);
         const QRadialGradient *grad = static_cast<const QRadialGradient*>(g);
         str << QLatin1String("<radialGradient ");
@@ -434,6 +668,7 @@ public:
         str << QLatin1String("id=\"") <<d_func()->generateGradientName(dataPrefix())<< QLatin1String("\">\n");
         saveGradientStops(str, g);
         str << QLatin1String("</radialGradient>") << endl;
+        d_func()->savedGradients.insert(key, d_func()->currentGradientName);
     }
     void saveConicalGradientBrush(const QGradient *)
     {
@@ -512,19 +747,46 @@ public:
         str << QLatin1String("<clipPath ");
         str << QLatin1String("id=\"") << id << QLatin1String("\">\n");
         const QPainterPath &p = d_func()->clipPath;
-        str << "<path d=\"";
+        QRectF rect;
+        if (isRectPath(p, &rect)) {
+            str << "<rect x=\"" << rect.x() << "\" y=\"" << rect.y()
+                << "\" width=\"" << rect.width() << "\" height=\"" << rect.height() << "\"/>" << endl;
+        } else {
+            str << "<path d=\"";
+            streamPathData(str, p);
+            str << "\"/>" << endl;
+        }
+        str << QLatin1String("</clipPath>") << endl;
+    }
+
+    // In compact mode, attributes matching the Qt defaults set on the
+    // outermost group are left out of the state groups, unless a user group
+    // in between may have set them to something else.
+    inline bool omitDefault(bool isDefault)
+    {
+        return isDefault && d_func()->compactGroupsEnabled && !d_func()->attributedGroups;
+    }
+
+    void streamPathData(QTextStream &str, const QPainterPath &p)
+    {
+        Q_D(QSvgPaintEngine);
+        QByteArray &out = d->numberBuffer;
+        out.truncate(0);
 
         for (int i=0; i<p.elementCount(); ++i) {
             const QPainterPath::Element &e = p.elementAt(i);
             switch (e.type) {
             case QPainterPath::MoveToElement:
-                str << 'M' << e.x << ',' << e.y;
+                out.append('M');
+                d->numberFormatter.appendPoint(out, e.x, e.y);
                 break;
             case QPainterPath::LineToElement:
-                str << 'L' << e.x << ',' << e.y;
+                out.append('L');
+                d->numberFormatter.appendPoint(out, e.x, e.y);
                 break;
             case QPainterPath::CurveToElement:
-                str << 'C' << e.x << ',' << e.y;
+                out.append('C');
+                d->numberFormatter.appendPoint(out, e.x, e.y);
                 ++i;
                 while (i < p.elementCount()) {
                     const QPainterPath::Element &e = p.elementAt(i);
@@ -532,8 +794,8 @@ public:
                         --i;
                         break;
                     } else
-                        str << ' ';
-                    str << e.x << ',' << e.y;
+                        out.append(' ');
+                    d->numberFormatter.appendPoint(out, e.x, e.y);
                     ++i;
                 }
                 break;
@@ -541,12 +803,26 @@ public:
                 break;
             }
             if (i != p.elementCount() - 1) {
-                str << ' ';
+                out.append(' ');
             }
         }
 
-        str << "\"/>" << endl;
-        str << QLatin1String("</clipPath>") << endl;
+        str << QLatin1String(out.constData(), out.size());
+    }
+
+    void streamMatrix(QTextStream &str, const QMatrix &m)
+    {
+        Q_D(QSvgPaintEngine);
+        QByteArray &out = d->numberBuffer;
+        out.truncate(0);
+        out.append("matrix(");
+        d->numberFormatter.appendPoint(out, m.m11(), m.m12());
+        out.append(',');
+        d->numberFormatter.appendPoint(out, m.m21(), m.m22());
+        out.append(',');
+        d->numberFormatter.appendPoint(out, m.dx(), m.dy());
+        out.append(')');
+        str << QLatin1String(out.constData(), out.size());
     }
 
     void generateQtDefaults()
@@ -562,6 +838,9 @@ public:
 
     inline QTextStream &stream()
     {
+        if (d_func()->stateStream)
+            return *d_func()->stateStream;
+
         if (trimEmptyGroupEnabled() && d_func()->discardStashStream)
             return stashStream();
 
@@ -582,6 +861,29 @@ public:
         d_func()->discardStashStream = false;
     }
 
+    // In streaming mode the defs and body buffers only hold what was produced
+    // since the last element; push them to the device so that every def lands
+    // in front of its first use.
+    void flushStreamingContent()
+    {
+        Q_D(QSvgPaintEngine);
+        if (!d->deviceStream)
+            return;
+
+        if (!d->defs.isEmpty()) {
+            *d->deviceStream << "<defs>\n" << d->defs << "</defs>\n";
+            d->defs.truncate(0);
+        }
+        if (!d->body.isEmpty()) {
+            *d->deviceStream << d->body;
+            d->body.truncate(0);
+        }
+        if (d->stashStream && d->stashStream->atEnd()) {
+            d->stashContent.truncate(0);
+            d->stashStream->setString(&d->stashContent);
+        }
+    }
+
     void qpenToSvg(const QPen &spen)
     {
         d_func()->pen = spen;
@@ -603,7 +905,8 @@ public:
             d_func()->attributes.strokeOpacity = colorOpacity;
 
             stream() << QLatin1String("stroke=\"")<<color<< QLatin1String("\" ");
-            stream() << QLatin1String("stroke-opacity=\"")<<colorOpacity<< QLatin1String("\" ");
+            if (!omitDefault(spen.color().alpha() == 255))
+                stream() << QLatin1String("stroke-opacity=\"")<<colorOpacity<< QLatin1String("\" ");
         }
             break;
         case Qt::DashLine:
@@ -637,17 +940,20 @@ public:
             break;
         }
 
-        if (spen.widthF() == 0)
-            stream() <<"stroke-width=\"1\" ";
-        else
+        if (spen.widthF() == 0) {
+            if (!omitDefault(true))
+                stream() <<"stroke-width=\"1\" ";
+        } else if (!omitDefault(spen.widthF() == 1)) {
             stream() <<"stroke-width=\"" << spen.widthF() << "\" ";
+        }
 
         switch (spen.capStyle()) {
         case Qt::FlatCap:
             stream() << "stroke-linecap=\"butt\" ";
             break;
         case Qt::SquareCap:
-            stream() << "stroke-linecap=\"square\" ";
+            if (!omitDefault(true))
+                stream() << "stroke-linecap=\"square\" ";
             break;
         case Qt::RoundCap:
             stream() << "stroke-linecap=\"round\" ";
@@ -662,7 +968,8 @@ public:
                         "stroke-miterlimit=\""<<spen.miterLimit()<<"\" ";
             break;
         case Qt::BevelJoin:
-            stream() << "stroke-linejoin=\"bevel\" ";
+            if (!omitDefault(true))
+                stream() << "stroke-linejoin=\"bevel\" ";
             break;
         case Qt::RoundJoin:
             stream() << "stroke-linejoin=\"round\" ";
@@ -678,9 +985,9 @@ public:
         case Qt::SolidPattern: {
             QString color, colorOpacity;
             translate_color(sbrush.color(), &color, &colorOpacity);
-            stream() << "fill=\"" << color << "\" "
-                        "fill-opacity=\""
-                     << colorOpacity << "\" ";
+            stream() << "fill=\"" << color << "\" ";
+            if (!omitDefault(sbrush.color().alpha() == 255))
+                stream() << "fill-opacity=\"" << colorOpacity << "\" ";
             d_func()->attributes.fill = color;
             d_func()->attributes.fillOpacity = colorOpacity;
         }
@@ -1208,6 +1515,162 @@ void QSvgGenerator::setTrimEmptyGroupEnabled(bool enable)
     d->engine->setTrimEmptyGroupEnabled(enable);
 }
 
+/*!
+    Returns whether the generator writes its output to the device while
+    painting instead of when painting ends.
+
+    \sa setStreamingEnabled()
+*/
+bool QSvgGenerator::streamingEnabled() const
+{
+    Q_D(const QSvgGenerator);
+    return d->engine->streamingEnabled();
+}
+
+/*!
+    Enables or disables streaming output, depending on \a enable.
+
+    By default the whole document is kept in memory and written to the output
+    device by QPainter::end(). In streaming mode every element is written out
+    as UTF-8 as soon as it is painted, and definitions such as gradients,
+    patterns and clip paths are emitted in a \c{<defs>} element right before
+    the content that first references them. Memory use then only grows with
+    the number of distinct definitions, not with the size of the drawing.
+
+    \note It is not possible to change this property while a QPainter is
+    active on the generator.
+*/
+void QSvgGenerator::setStreamingEnabled(bool enable)
+{
+    Q_D(QSvgGenerator);
+    if (d->engine->isActive()) {
+        qWarning("QSvgGenerator::setStreamingEnabled(), cannot change streaming while SVG is being generated");
+        return;
+    }
+    d->engine->setStreamingEnabled(enable);
+}
+
+/*!
+    Returns the format used to embed raster images.
+
+    \sa setImageFormat()
+*/
+QByteArray QSvgGenerator::imageFormat() const
+{
+    Q_D(const QSvgGenerator);
+    return d->engine->imageFormat();
+}
+
+/*!
+    Sets the format used to embed raster images to \a format, which can be
+    \c{"png"} (the default) or \c{"jpeg"}. Images with transparent pixels
+    are always embedded as PNG.
+
+    Every distinct image is embedded only once; drawing the same image again
+    references the existing copy.
+
+    \sa setImageQuality()
+*/
+void QSvgGenerator::setImageFormat(const QByteArray &format)
+{
+    Q_D(QSvgGenerator);
+    if (d->engine->isActive()) {
+        qWarning("QSvgGenerator::setImageFormat(), cannot set image format while SVG is being generated");
+        return;
+    }
+    d->engine->setImageFormat(format);
+}
+
+/*!
+    Returns the quality used to encode embedded raster images.
+
+    \sa setImageQuality()
+*/
+int QSvgGenerator::imageQuality() const
+{
+    Q_D(const QSvgGenerator);
+    return d->engine->imageQuality();
+}
+
+/*!
+    Sets the \a quality used to encode embedded raster images, as in
+    QImageWriter::setQuality(). For PNG it selects the compression level;
+    the default of -1 uses the encoder's default settings.
+
+    \sa setImageFormat()
+*/
+void QSvgGenerator::setImageQuality(int quality)
+{
+    Q_D(QSvgGenerator);
+    if (d->engine->isActive()) {
+        qWarning("QSvgGenerator::setImageQuality(), cannot set image quality while SVG is being generated");
+        return;
+    }
+    d->engine->setImageQuality(quality);
+}
+
+/*!
+    Returns whether the state groups written for painter state changes are
+    kept as small as possible.
+
+    \sa setCompactGroupsEnabled()
+*/
+bool QSvgGenerator::compactGroupsEnabled() const
+{
+    Q_D(const QSvgGenerator);
+    return d->engine->compactGroupsEnabled();
+}
+
+/*!
+    Enables or disables compact state groups, depending on \a enable.
+
+    Every painter state change is written as a \c{<g>} element carrying the
+    complete pen, brush, transform and font. With compact groups a state
+    change that results in the same attributes as the current group does
+    not start a new group, attributes equal to the document defaults (such
+    as an identity transform or an opaque color's opacity) are left out,
+    and fonts are only written on text elements, which specify them anyway.
+    Combined with trimEmptyGroupEnabled() this removes most redundant groups
+    from drawings that change state often.
+*/
+void QSvgGenerator::setCompactGroupsEnabled(bool enable)
+{
+    Q_D(QSvgGenerator);
+    if (d->engine->isActive()) {
+        qWarning("QSvgGenerator::setCompactGroupsEnabled(), cannot change groups while SVG is being generated");
+        return;
+    }
+    d->engine->setCompactGroupsEnabled(enable);
+}
+
+/*!
+    Returns the number of significant digits written for path data,
+    transforms and coordinate lists.
+
+    \sa setCoordinatePrecision()
+*/
+int QSvgGenerator::coordinatePrecision() const
+{
+    Q_D(const QSvgGenerator);
+    return d->engine->coordinatePrecision();
+}
+
+/*!
+    Sets the number of significant digits written for path data, transforms
+    and coordinate lists to \a precision. The default is 6; lower values
+    produce smaller files. Pass QLocale::FloatingPointShortest to write the
+    shortest text that reads back as exactly the same value.
+*/
+void QSvgGenerator::setCoordinatePrecision(int precision)
+{
+    Q_D(QSvgGenerator);
+    if (d->engine->isActive()) {
+        qWarning("QSvgGenerator::setCoordinatePrecision(), cannot set precision while SVG is being generated");
+        return;
+    }
+    d->engine->setCoordinatePrecision(precision);
+}
+
 QString QSvgGenerator::dataPrefix() const
 {
     Q_D(const QSvgGenerator);
@@ -1305,6 +1768,9 @@ bool QSvgPaintEngine::begin(QPaintDevice *)
         return false;
     }
 
+    d->userGroups.clear();
+    d->attributedGroups = 0;
+
     d->stream = new QTextStream(&d->header);
     if (trimEmptyGroupEnabled())
         d->stashStream.reset(new QTextStream(&d->stashContent));
@@ -1335,14 +1801,24 @@ bool QSvgPaintEngine::begin(QPaintDevice *)
         *d->stream << "<desc>" << d->attributes.document_description << "</desc>" << endl;
     }
 
-    d->stream->setString(&d->defs);
-    *d->stream << "<defs>\n";
+    if (d->streamingEnabled) {
+        d->deviceStream.reset(new QTextStream(d->outputDevice));
+#ifndef QT_NO_TEXTCODEC
+        d->deviceStream->setCodec(QTextCodec::codecForName("UTF-8"));
+#endif
+        *d->deviceStream << d->header;
+        d->header.clear();
+    } else {
+        d->stream->setString(&d->defs);
+        *d->stream << "<defs>\n";
+    }
 
     d->stream->setString(&d->body);
     // Start the initial graphics state...
     *d->stream << "<g ";
     generateQtDefaults();
     *d->stream << endl;
+    flushStreamingContent();
 
     return true;
 }
@@ -1351,6 +1827,19 @@ bool QSvgPaintEngine::end()
 {
     Q_D(QSvgPaintEngine);
 
+    if (d->deviceStream) {
+        if (d->afterFirstUpdate && !d->discardStashStream)
+            *d->stream << "</g>" << endl; // close the updateState
+        *d->stream << "</g>" << endl // close the Qt defaults
+                   << "</svg>" << endl;
+        flushStreamingContent();
+        d->deviceStream->flush();
+        d->deviceStream.reset();
+
+        delete d->stream;
+        return true;
+    }
+
     d->stream->setString(&d->defs);
     *d->stream << "</defs>\n";
 
@@ -1391,34 +1880,27 @@ void QSvgPaintEngine::drawImage(const QRectF &r, const QImage &image,
 
     QRectF baseSize(0, 0, image.width(), image.height());
     QImage im = image;
-    if (baseSize != sr)
+    const bool wholeImage = baseSize == sr;
+    if (!wholeImage)
         im = im.copy(sr.toAlignedRect());
 
     if (im.isNull())
         return;
 
+    const QString imageId = saveImage(im, wholeImage ? image.cacheKey() : 0);
+
     QString shapeInfo = image.text("shapeInfo");
     if (!shapeInfo.isEmpty())
         stream() << "<g id=\"wo_shape\" data-description=\"shapeInfo_"<<shapeInfo<<"\">";
 
-    stream() << "<image ";
-    stream() << "x=\""<<r.x()<<"\" "
-                "y=\""<<r.y()<<"\" "
-                "width=\""<<r.width()<<"\" "
-                "height=\""<<r.height()<<"\" "
-                "preserveAspectRatio=\"none\" ";
-
-    QByteArray data;
-    QBuffer buffer(&data);
-    buffer.open(QBuffer::ReadWrite);
-    im.save(&buffer, "PNG");
-    buffer.close();
-    stream() << "xlink:href=\"data:image/png;base64,"
-             << data.toBase64()
-             <<"\" />\n";
-    
+    // the shared image is defined at its pixel size at the origin
+    stream() << "<use xlink:href=\"#" << imageId << "\" "
+                "transform=\"matrix(" << r.width() / im.width() << ",0,0,"
+             << r.height() / im.height() << ',' << r.x() << ',' << r.y() << ")\" />\n";
+
     if (!shapeInfo.isEmpty())
         stream() << "</g>";
+    flushStreamingContent();
 }
 
 void QSvgPaintEngine::updateState(const QPaintEngineState &state)
@@ -1436,17 +1918,11 @@ void QSvgPaintEngine::updateState(const QPaintEngineState &state)
              QPaintEngine::DirtyFont |
              QPaintEngine::DirtyOpacity;
 
-    // close old state and start a new one...
-    if (d->afterFirstUpdate)
-    {
-        stream() << "</g>\n\n";
-        if (trimEmptyGroupEnabled())
-            stashStream().readAll();
-    }
-
-    d->discardStashStream = trimEmptyGroupEnabled();
-
-    stream() << "<g ";
+    // Collect the attributes of the new state first, so that an update which
+    // ends up with the same group as the open one can be dropped.
+    QString attributes;
+    QTextStream attributeStream(&attributes);
+    d->stateStream = &attributeStream;
 
     if (flags & QPaintEngine::DirtyBrush) {
         qbrushToSvg(state.brush());
@@ -1458,16 +1934,19 @@ void QSvgPaintEngine::updateState(const QPaintEngineState &state)
 
     if (flags & QPaintEngine::DirtyTransform) {
         d->matrix = state.matrix();
-        stream() << "transform=\"matrix(" << d->matrix.m11() << ','
-                   << d->matrix.m12() << ','
-                   << d->matrix.m21() << ',' << d->matrix.m22() << ','
-                   << d->matrix.dx() << ',' << d->matrix.dy()
-                   << ")\""
-                   << endl;
+        if (!omitDefault(d->matrix.isIdentity())) {
+            stream() << "transform=\"";
+            streamMatrix(stream(), d->matrix);
+            stream() << '"' << endl;
+        }
     }
 
     if (flags & QPaintEngine::DirtyFont) {
-        qfontToSvg(state.font());
+        // <text> elements carry their own font attributes
+        if (compactGroupsEnabled())
+            d->font = state.font();
+        else
+            qfontToSvg(state.font());
     }
 
     if (flags & QPaintEngine::DirtyOpacity) {
@@ -1498,9 +1977,28 @@ void QSvgPaintEngine::updateState(const QPaintEngineState &state)
             stream() << QStringLiteral("clip-path=\"url(#%1)\" ").arg(id);
     }
 
-    stream() << '>' << endl;
+    d->stateStream = nullptr;
+
+    if (compactGroupsEnabled() && d->afterFirstUpdate && attributes == d->stateAttributes) {
+        flushStreamingContent(); // defs created above
+        return;
+    }
+    d->stateAttributes = attributes;
+
+    // close old state and start a new one...
+    if (d->afterFirstUpdate)
+    {
+        stream() << "</g>\n\n";
+        if (trimEmptyGroupEnabled())
+            stashStream().readAll();
+    }
+
+    d->discardStashStream = trimEmptyGroupEnabled();
+
+    stream() << "<g " << attributes << '>' << endl;
 
     d->afterFirstUpdate = true;
+    flushStreamingContent();
 }
 
 void QSvgPaintEngine::drawEllipse(const QRectF &r)
@@ -1520,6 +2018,7 @@ void QSvgPaintEngine::drawEllipse(const QRectF &r)
     else
         *d->stream << "\" rx=\"" << r.width() / qreal(2.0) << "\" ry=\"" << r.height() / qreal(2.0);
     *d->stream << "\"/>" << endl;
+    flushStreamingContent();
 }
 
 void QSvgPaintEngine::drawPath(const QPainterPath &p)
@@ -1533,39 +2032,9 @@ void QSvgPaintEngine::drawPath(const QPainterPath &p)
                << "\" fill-rule=\""
                << (p.fillRule() == Qt::OddEvenFill ? "evenodd" : "nonzero")
                << "\" d=\"";
-
-    for (int i=0; i<p.elementCount(); ++i) {
-        const QPainterPath::Element &e = p.elementAt(i);
-        switch (e.type) {
-        case QPainterPath::MoveToElement:
-            *d->stream << 'M' << e.x << ',' << e.y;
-            break;
-        case QPainterPath::LineToElement:
-            *d->stream << 'L' << e.x << ',' << e.y;
-            break;
-        case QPainterPath::CurveToElement:
-            *d->stream << 'C' << e.x << ',' << e.y;
-            ++i;
-            while (i < p.elementCount()) {
-                const QPainterPath::Element &e = p.elementAt(i);
-                if (e.type != QPainterPath::CurveToDataElement) {
-                    --i;
-                    break;
-                } else
-                    *d->stream << ' ';
-                *d->stream << e.x << ',' << e.y;
-                ++i;
-            }
-            break;
-        default:
-            break;
-        }
-        if (i != p.elementCount() - 1) {
-            *d->stream << ' ';
-        }
-    }
-
+    streamPathData(*d->stream, p);
     *d->stream << "\"/>" << endl;
+    flushStreamingContent();
 }
 
 void QSvgPaintEngine::drawPolygon(const QPointF *points, int pointCount,
@@ -1582,14 +2051,19 @@ void QSvgPaintEngine::drawPolygon(const QPointF *points, int pointCount,
         path.lineTo(points[i]);
 
     if (mode == PolylineMode) {
-        stream() << "<polyline fill=\"none\" vector-effect=\""
-                 << (state->pen().isCosmetic() ? "non-scaling-stroke" : "none")
-                 << "\" points=\"";
+        Q_D(QSvgPaintEngine);
+        QByteArray &out = d->numberBuffer;
+        out.truncate(0);
         for (int i = 0; i < pointCount; ++i) {
             const QPointF &pt = points[i];
-            stream() << pt.x() << ',' << pt.y() << ' ';
+            d->numberFormatter.appendPoint(out, pt.x(), pt.y());
+            out.append(' ');
         }
+        stream() << "<polyline fill=\"none\" vector-effect=\""
+                 << (state->pen().isCosmetic() ? "non-scaling-stroke" : "none")
+                 << "\" points=\"" << QLatin1String(out.constData(), out.size());
         stream() << "\" />" <<endl;
+        flushStreamingContent();
     } else {
         path.closeSubpath();
         drawPath(path);
@@ -1625,6 +2099,7 @@ void QSvgPaintEngine::drawRects(const QRectF *rects, int rectCount)
 
         *d->stream << "\"/>" << endl;
     }
+    flushStreamingContent();
 }
 
 void QSvgPaintEngine::drawTextItem(const QPointF &pt, const QTextItem &textItem)
@@ -1664,25 +2139,28 @@ void QSvgPaintEngine::drawTextItem(const QPointF &pt, const QTextItem &textItem)
         const QFixedPoint* positions = ti.glyphs.offsets;
         qreal x = pt.x();
         qreal y = pt.y();
-        *d->stream << "x=\"";
+        QByteArray &out = d->numberBuffer;
+        out.truncate(0);
+        out.append("x=\"");
         for (int i = 0; i < ti.glyphs.numGlyphs; ++i)
         {
             x += (positions + i)->x.toReal();
-            *d->stream << x;
+            d->numberFormatter.appendNumber(out, x);
             if (i < ti.glyphs.numGlyphs - 1)
-                *d->stream << " ";
+                out.append(' ');
             x += ti.glyphs.advances[i].toReal();
         }
 
-        *d->stream << "\" y=\"";
+        out.append("\" y=\"");
         for (int i = 0; i < ti.glyphs.numGlyphs; ++i)
         {
-            *d->stream << y + (positions + i)->y.toReal();
+            d->numberFormatter.appendNumber(out, y + (positions + i)->y.toReal());
             if (i < ti.glyphs.numGlyphs - 1)
-                *d->stream << " ";
+                out.append(' ');
         }
 
-        *d->stream << "\" ";
+        out.append("\" ");
+        *d->stream << QLatin1String(out.constData(), out.size());
     }
 
     qfontToSvg(textItem.font());
@@ -1690,6 +2168,7 @@ void QSvgPaintEngine::drawTextItem(const QPointF &pt, const QTextItem &textItem)
                << s.toHtmlEscaped()
                << "</text>"
                << endl;
+    flushStreamingContent();
 }
 
 QT_END_NAMESPACE
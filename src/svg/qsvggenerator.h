@@ -45,6 +45,7 @@
 #ifndef QT_NO_SVGGENERATOR
 
 #include <QtCore/qnamespace.h>
+#include <QtCore/qbytearray.h>
 #include <QtCore/qiodevice.h>
 #include <QtCore/qobjectdefs.h>
 #include <QtCore/qscopedpointer.h>
@@ -102,6 +103,21 @@ public:
     bool trimEmptyGroupEnabled() const;
     void setTrimEmptyGroupEnabled(bool enable);
 
+    bool streamingEnabled() const;
+    void setStreamingEnabled(bool enable);
+
+    QByteArray imageFormat() const;
+    void setImageFormat(const QByteArray &format);
+
+    int imageQuality() const;
+    void setImageQuality(int quality);
+
+    bool compactGroupsEnabled() const;
+    void setCompactGroupsEnabled(bool enable);
+
+    int coordinatePrecision() const;
+    void setCoordinatePrecision(int precision);
+
     QString dataPrefix() const;
     void setDataPrefix(const QString& prefix);
 
@@ -43,7 +43,10 @@
 #include "qsvgfont_p.h"
 
 #include <qabstracttextdocumentlayout.h>
+#include <qcache.h>
 #include <qdebug.h>
+#include <qmath.h>
+#include <qmutex.h>
 #include <qpainter.h>
 #include <qscopedvaluerollback.h>
 #include <qtextcursor.h>
@@ -54,19 +57,31 @@
 
 QT_BEGIN_NAMESPACE
 
+// Fills with the fill opacity, then strokes with the stroke opacity. When
+// both opacities are equal one call does both, as the engine fills before
+// it strokes anyway, and no pen or brush has to be swapped.
 #define QT_SVG_DRAW_SHAPE(command)                          \
     qreal oldOpacity = p->opacity();                        \
     QBrush oldBrush = p->brush();                           \
     QPen oldPen = p->pen();                                 \
-    p->setPen(Qt::NoPen);                                   \
-    p->setOpacity(oldOpacity * states.fillOpacity);         \
-    command;                                                \
-    p->setPen(oldPen);                                      \
-    if (oldPen != Qt::NoPen && oldPen.brush() != Qt::NoBrush && oldPen.widthF() != 0) { \
-        p->setOpacity(oldOpacity * states.strokeOpacity);   \
-        p->setBrush(Qt::NoBrush);                           \
+    const bool filled = oldBrush.style() != Qt::NoBrush;    \
+    const bool stroked = oldPen != Qt::NoPen && oldPen.brush() != Qt::NoBrush && oldPen.widthF() != 0; \
+    if (filled && stroked && states.fillOpacity == states.strokeOpacity) { \
+        p->setOpacity(oldOpacity * states.fillOpacity);     \
         command;                                            \
-        p->setBrush(oldBrush);                              \
+    } else {                                                \
+        if (filled) {                                       \
+            p->setPen(Qt::NoPen);                           \
+            p->setOpacity(oldOpacity * states.fillOpacity); \
+            command;                                        \
+            p->setPen(oldPen);                              \
+        }                                                   \
+        if (stroked) {                                      \
+            p->setOpacity(oldOpacity * states.strokeOpacity); \
+            p->setBrush(Qt::NoBrush);                       \
+            command;                                        \
+            p->setBrush(oldBrush);                          \
+        }                                                   \
     }                                                       \
     p->setOpacity(oldOpacity);
 
@@ -380,12 +395,36 @@ void QSvgAnimation::draw(QPainter *, QSvgExtraStates &)
     qWarning("<animation> no implemented");
 }
 
-static inline QRectF boundsOnStroke(QPainter *p, const QPainterPath &path, qreal width)
+static inline QRectF mappedBounds(const QTransform &t, const QPainterPath &path)
 {
-    QPainterPathStroker stroker;
-    stroker.setWidth(width);
-    QPainterPath stroke = stroker.createStroke(path);
-    return p->transform().map(stroke).boundingRect();
+    return t.type() <= QTransform::TxScale ? t.mapRect(path.boundingRect())
+                                           : t.map(path).boundingRect();
+}
+
+static inline QRectF mappedBounds(const QTransform &t, const QPolygonF &poly)
+{
+    return t.type() <= QTransform::TxScale ? t.mapRect(poly.boundingRect())
+                                           : t.map(poly).boundingRect();
+}
+
+static bool hasOpenSubpath(const QPainterPath &path)
+{
+    const int count = path.elementCount();
+    QPointF start;
+    for (int i = 0; i < count; ++i) {
+        const QPainterPath::Element &e = path.elementAt(i);
+        if (e.isMoveTo()) {
+            if (i > 0 && QPointF(path.elementAt(i - 1)) != start)
+                return true;
+            start = e;
+        }
+    }
+    return count > 0 && QPointF(path.elementAt(count - 1)) != start;
+}
+
+static inline bool hasOpenEnds(const QPainterPath &path, const QSvgBoundsState &state)
+{
+    return !qFuzzyIsNull(state.strokeWidth()) && hasOpenSubpath(path);
 }
 
 QSvgEllipse::QSvgEllipse(QSvgNode *parent, const QRectF &rect)
@@ -394,12 +433,15 @@ QSvgEllipse::QSvgEllipse(QSvgNode *parent, const QRectF &rect)
 }
 
 
-QRectF QSvgEllipse::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgEllipse::bounds(const QSvgBoundsState &state, bool) const
 {
-    QPainterPath path;
-    path.addEllipse(m_bounds);
-    qreal sw = strokeWidth(p);
-    return qFuzzyIsNull(sw) ? p->transform().map(path).boundingRect() : boundsOnStroke(p, path, sw);
+    const QTransform &t = state.transform;
+    const qreal rx = m_bounds.width() / 2;
+    const qreal ry = m_bounds.height() / 2;
+    const qreal ex = qSqrt(t.m11() * rx * t.m11() * rx + t.m21() * ry * t.m21() * ry);
+    const qreal ey = qSqrt(t.m12() * rx * t.m12() * rx + t.m22() * ry * t.m22() * ry);
+    const QPointF c = t.map(m_bounds.center());
+    return strokedBounds(QRectF(c.x() - ex, c.y() - ey, 2 * ex, 2 * ey), state, false);
 }
 
 QSvgNode *QSvgEllipse::getFillPattern()
@@ -416,6 +458,7 @@ void QSvgEllipse::updateFillPattern(QSvgNode* fillPattern)
 void QSvgEllipse::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
 
     bool isRatioInPattern = isRatioChildInPattern(this);
     if (isRatioInPattern)
@@ -450,6 +493,7 @@ QSvgArc::QSvgArc(QSvgNode *parent, const QPainterPath &path)
 void QSvgArc::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
     if (p->pen().widthF() != 0) {
         qreal oldOpacity = p->opacity();
         p->setOpacity(oldOpacity * states.strokeOpacity);
@@ -459,10 +503,26 @@ void QSvgArc::draw(QPainter *p, QSvgExtraStates &states)
     revertStyle(p, states);
 }
 
+// Images decoded from encoded data are kept here rather than in the nodes,
+// so documents that embed many large pictures only hold the ones in use.
+// The cost of an entry is its size in kilobytes; an image larger than the
+// whole cache takes all of it until the next one is decoded.
+struct QSvgImageCache
+{
+    QSvgImageCache() : images(64 * 1024) {}
+
+    QMutex mutex;
+    QCache<quint64, QImage> images;
+};
+
+Q_GLOBAL_STATIC(QSvgImageCache, imageCache)
+static QAtomicInteger<quint64> imageCacheSerial;
+
 QSvgImage::QSvgImage(QSvgNode *parent, const QImage &image,
                      const QRectF &bounds)
     : QSvgNode(parent), m_image(image),
-      m_bounds(bounds)
+      m_bounds(bounds), m_imageSize(image.size()), m_cacheKey(0),
+      m_decodeFailed(false)
 {
     if (m_bounds.width() == 0.0)
         m_bounds.setWidth(static_cast<qreal>(m_image.width()));
@@ -470,9 +530,74 @@ QSvgImage::QSvgImage(QSvgNode *parent, const QImage &image,
         m_bounds.setHeight(static_cast<qreal>(m_image.height()));
 }
 
+QSvgImage::QSvgImage(QSvgNode *parent, const QByteArray &encodedData,
+                     const QString &mimeType, const QSize &imageSize,
+                     const QRectF &bounds)
+    : QSvgNode(parent), m_bounds(bounds), m_imageSize(imageSize),
+      m_encodedData(encodedData), m_mimeType(mimeType),
+      m_cacheKey(++imageCacheSerial), m_decodeFailed(false)
+{
+    if (m_bounds.width() == 0.0)
+        m_bounds.setWidth(static_cast<qreal>(m_imageSize.width()));
+    if (m_bounds.height() == 0.0)
+        m_bounds.setHeight(static_cast<qreal>(m_imageSize.height()));
+}
+
+QSvgImage::~QSvgImage()
+{
+    if (m_cacheKey && imageCache.exists()) {
+        QMutexLocker locker(&imageCache->mutex);
+        imageCache->images.remove(m_cacheKey);
+    }
+}
+
+bool QSvgImage::isDecoded() const
+{
+    if (!m_cacheKey)
+        return !m_image.isNull();
+
+    QSvgImageCache *cache = imageCache();
+    if (!cache)
+        return false;
+    QMutexLocker locker(&cache->mutex);
+    return cache->images.contains(m_cacheKey);
+}
+
+QImage QSvgImage::image() const
+{
+    if (!m_cacheKey || m_decodeFailed)
+        return m_image;
+
+    QSvgImageCache *cache = imageCache();
+    if (cache) {
+        QMutexLocker locker(&cache->mutex);
+        if (const QImage *image = cache->images.object(m_cacheKey))
+            return *image;
+    }
+
+    QImage image = QImage::fromData(m_encodedData);
+    if (image.isNull()) {
+        qWarning("QSvgImage::image(), could not decode the embedded %s image",
+                 qPrintable(m_mimeType));
+        m_decodeFailed = true;
+        return image;
+    }
+    if (image.format() == QImage::Format_ARGB32)
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    if (cache) {
+        // QCache refuses entries costing more than the whole cache
+        const int cost = qBound(1, int(image.sizeInBytes() / 1024), cache->images.maxCost());
+        QMutexLocker locker(&cache->mutex);
+        cache->images.insert(m_cacheKey, new QImage(image), cost);
+    }
+    return image;
+}
+
 void QSvgImage::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
 
     qreal oldOpacity = p->opacity();
     p->setOpacity(oldOpacity * states.fillOpacity);
@@ -484,11 +609,12 @@ void QSvgImage::draw(QPainter *p, QSvgExtraStates &states)
 #ifndef QT_NO_EXCEPTIONS
     try {
 #endif
+        const QImage image = this->image();
         if (auto tinydoc = document()) {
-            const QPixmap &pixmap = tinydoc->convertToPixmap(p, m_image);
-            p->drawPixmap(m_bounds, pixmap, QRectF(0, 0, m_image.width(), m_image.height()));
+            const QPixmap &pixmap = tinydoc->convertToPixmap(p, image);
+            p->drawPixmap(m_bounds, pixmap, QRectF(0, 0, image.width(), image.height()));
         } else {
-            p->drawImage(m_bounds, m_image);
+            p->drawImage(m_bounds, image);
         }
 #ifndef QT_NO_EXCEPTIONS
     } catch (const std::exception &) {
@@ -512,6 +638,7 @@ QSvgLine::QSvgLine(QSvgNode *parent, const QLineF &line)
 void QSvgLine::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
 
     bool isRatioInPattern = isRatioChildInPattern(this);
     if (isRatioInPattern)
@@ -556,6 +683,7 @@ QSvgPath::QSvgPath(QSvgNode *parent, const QPainterPath &qpath)
 void QSvgPath::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
     m_path.setFillRule(states.fillRule);
 
     bool isRatioInPattern = isRatioChildInPattern(this);
@@ -604,11 +732,9 @@ void QSvgPath::updateFillPattern(QSvgNode* fillPattern)
     m_fillPattern = static_cast<QSvgPattern *>(fillPattern);
 }
 
-QRectF QSvgPath::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgPath::bounds(const QSvgBoundsState &state, bool) const
 {
-    qreal sw = strokeWidth(p);
-    return qFuzzyIsNull(sw) ? p->transform().map(m_path).boundingRect()
-        : boundsOnStroke(p, m_path, sw);
+    return strokedBounds(mappedBounds(state.transform, m_path), state, hasOpenEnds(m_path, state));
 }
 
 QSvgPolygon::QSvgPolygon(QSvgNode *parent, const QPolygonF &poly)
@@ -616,16 +742,9 @@ QSvgPolygon::QSvgPolygon(QSvgNode *parent, const QPolygonF &poly)
 {
 }
 
-QRectF QSvgPolygon::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgPolygon::bounds(const QSvgBoundsState &state, bool) const
 {
-    qreal sw = strokeWidth(p);
-    if (qFuzzyIsNull(sw)) {
-        return p->transform().map(m_poly).boundingRect();
-    } else {
-        QPainterPath path;
-        path.addPolygon(m_poly);
-        return boundsOnStroke(p, path, sw);
-    }
+    return strokedBounds(mappedBounds(state.transform, m_poly), state, false);
 }
 
 QSvgNode *QSvgPolygon::getFillPattern()
@@ -642,6 +761,7 @@ void QSvgPolygon::updateFillPattern(QSvgNode* fillPattern)
 void QSvgPolygon::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
 
     bool isRatioInPattern = isRatioChildInPattern(this);
     if (isRatioInPattern)
@@ -687,6 +807,7 @@ QSvgPolyline::QSvgPolyline(QSvgNode *parent, const QPolygonF &poly)
 void QSvgPolyline::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
 
     bool isRatioInPattern = isRatioChildInPattern(this);
     if (isRatioInPattern)
@@ -752,16 +873,9 @@ QSvgRect::QSvgRect(QSvgNode *node, const QRectF &rect, int rx, int ry)
 {
 }
 
-QRectF QSvgRect::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgRect::bounds(const QSvgBoundsState &state, bool) const
 {
-    qreal sw = strokeWidth(p);
-    if (qFuzzyIsNull(sw)) {
-        return p->transform().mapRect(m_rect);
-    } else {
-        QPainterPath path;
-        path.addRect(m_rect);
-        return boundsOnStroke(p, path, sw);
-    }
+    return strokedBounds(state.transform.mapRect(m_rect), state, false);
 }
 
 QSvgNode *QSvgRect::getFillPattern()
@@ -778,6 +892,7 @@ void QSvgRect::updateFillPattern(QSvgNode* fillPattern)
 void QSvgRect::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
 
     bool isRatioInPattern = isRatioChildInPattern(this);
     if (isRatioInPattern)
@@ -851,6 +966,15 @@ QSvgText::~QSvgText()
     }
 }
 
+void QSvgText::setDocument(QSvgTinyDocument *doc)
+{
+    QSvgNode::setDocument(doc);
+    for (QSvgTspan *tspan : qAsConst(m_tspans)) {
+        if (tspan != LINEBREAK)
+            tspan->setDocument(doc);
+    }
+}
+
 qreal QSvgText::lineWidth(QString graph, QTextLayout::FormatRange formatRange, qreal scale,
                           const QVector<QPointF> &offsets, const QSvgFont *svgFont)
 {
@@ -952,15 +1076,15 @@ void QSvgText::processTspansFormats(QSvgTspan *tspan, QPainter *p, QSvgExtraStat
 {
     for (int i = 0, cnt = tspan->segments(); i < cnt; ++i) {
         tspan->applyStyle(p, states);
-        QFont font = p->font();
-        QPen pen = p->pen();
+        QFont font = states.painter.font(p);
+        QPen pen = states.painter.pen(p);
         font.setPixelSize(font.pointSizeF() * scale);
         pen.setWidthF(pen.widthF() * scale);
         QTextLayout::FormatRange range;
         range.start = 0;
         range.format.setFont(font);
         range.format.setTextOutline(pen);
-        range.format.setForeground(p->brush());
+        range.format.setForeground(states.painter.brush(p));
         m_formatRanges.push_back(range);
         tspan->revertStyle(p, states);
     }
@@ -1037,6 +1161,7 @@ void QSvgText::setTextArea(const QSizeF &size)
 void QSvgText::draw(QPainter *p, QSvgExtraStates &states)
 {
     applyStyle(p, states);
+    states.painter.flush(p);
     qreal oldOpacity = p->opacity();
     p->setOpacity(oldOpacity * states.fillOpacity);
 
@@ -1047,6 +1172,8 @@ void QSvgText::draw(QPainter *p, QSvgExtraStates &states)
     p->scale(1 / scale, 1 / scale);
 
     resolveTspans(p, states, scale);
+    // the tspans only recorded their styles, bring back the text's own
+    states.painter.flush(p);
 
     QPointF nextPos = m_coord;
     for (int i = 0, cnt = m_paragraphs.size(); i < cnt; ++i) {
@@ -1111,7 +1238,7 @@ void QSvgTspan::updateOffsetY(QPainter *p, QSvgExtraStates &states)
 
     applyStyle(p, states);
 
-    qreal fontSize = p->font().pointSize();
+    qreal fontSize = states.painter.font(p).pointSize();
     for (int i = 0; i < m_offsetY.size(); ++i)
     {
         if (m_offsetYType[i] == LT_EM)
@@ -1144,6 +1271,13 @@ QSvgTspan::~QSvgTspan()
     qDeleteAll(m_renderers);
 }
 
+void QSvgTspan::setDocument(QSvgTinyDocument *doc)
+{
+    QSvgNode::setDocument(doc);
+    for (QSvgTspan *tspan : qAsConst(m_renderers))
+        tspan->setDocument(doc);
+}
+
 QSvgUse::QSvgUse(const QPointF &start, QSvgNode *parent, QSvgNode *node)
     : QSvgNode(parent), m_link(node), m_start(start), m_recursing(false)
 {
@@ -1234,7 +1368,10 @@ QSvgNode *QSvgEllipse::clone(QSvgNode *parent)
 
 QSvgNode *QSvgImage::clone(QSvgNode *parent)
 {
-    QSvgNode *newNode = new QSvgImage(*this);
+    QSvgImage *newNode = new QSvgImage(*this);
+    // the cache entry is removed with its node, so the clone needs its own
+    if (m_cacheKey)
+        newNode->m_cacheKey = ++imageCacheSerial;
     newNode->setParent(parent);
     return newNode;
 }
@@ -1353,59 +1490,39 @@ QSvgNode::Type QSvgVideo::type() const
     return VIDEO;
 }
 
-QRectF QSvgUse::bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const
+QRectF QSvgUse::bounds(const QSvgBoundsState &state, bool defaultViewCoord) const
 {
     QRectF bounds;
     if (Q_LIKELY(m_link && !isDescendantOf(m_link) && !m_recursing)) {
         QScopedValueRollback<bool> guard(m_recursing, true);
-        p->translate(m_start);
-        bounds = m_link->transformedBounds(p, states, defaultViewCoord);
-        p->translate(-m_start);
+        QSvgBoundsState linkState = state;
+        linkState.transform = QTransform::fromTranslate(m_start.x(), m_start.y()) * state.transform;
+        bounds = m_link->transformedBounds(linkState, defaultViewCoord);
     }
     return bounds;
 }
 
-QRectF QSvgPolyline::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgPolyline::bounds(const QSvgBoundsState &state, bool) const
 {
-    qreal sw = strokeWidth(p);
-    if (qFuzzyIsNull(sw)) {
-        return p->transform().map(m_poly).boundingRect();
-    } else {
-        QPainterPath path;
-        path.addPolygon(m_poly);
-        return boundsOnStroke(p, path, sw);
-    }
+    return strokedBounds(mappedBounds(state.transform, m_poly), state, !m_poly.isClosed());
 }
 
-QRectF QSvgArc::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgArc::bounds(const QSvgBoundsState &state, bool) const
 {
-    qreal sw = strokeWidth(p);
-    return qFuzzyIsNull(sw) ? p->transform().map(m_path).boundingRect()
-        : boundsOnStroke(p, m_path, sw);
+    return strokedBounds(mappedBounds(state.transform, m_path), state, hasOpenEnds(m_path, state));
 }
 
-QRectF QSvgImage::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgImage::bounds(const QSvgBoundsState &state, bool) const
 {
-    return p->transform().mapRect(m_bounds);
+    return state.transform.mapRect(m_bounds);
 }
 
-QRectF QSvgLine::bounds(QPainter *p, QSvgExtraStates &, bool) const
+QRectF QSvgLine::bounds(const QSvgBoundsState &state, bool) const
 {
-    qreal sw = strokeWidth(p);
-    if (qFuzzyIsNull(sw)) {
-        QPointF p1 = p->transform().map(m_line.p1());
-        QPointF p2 = p->transform().map(m_line.p2());
-        qreal minX = qMin(p1.x(), p2.x());
-        qreal minY = qMin(p1.y(), p2.y());
-        qreal maxX = qMax(p1.x(), p2.x());
-        qreal maxY = qMax(p1.y(), p2.y());
-        return QRectF(minX, minY, maxX - minX, maxY - minY);
-    } else {
-        QPainterPath path;
-        path.moveTo(m_line.p1());
-        path.lineTo(m_line.p2());
-        return boundsOnStroke(p, path, sw);
-    }
+    const QPointF p1 = state.transform.map(m_line.p1());
+    const QPointF p2 = state.transform.map(m_line.p2());
+    const QRectF rect = QRectF(p1, p2).normalized();
+    return strokedBounds(rect, state, true);
 }
 
 QT_END_NAMESPACE
@@ -110,7 +110,7 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
 private:
     QPainterPath m_path;
 };
@@ -122,7 +122,7 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     QSvgNode *getFillPattern() override;
     void updateFillPattern(QSvgNode* fillPattern) override;
 
@@ -145,16 +145,33 @@ class Q_SVG_PRIVATE_EXPORT QSvgImage : public QSvgNode
 public:
     QSvgImage(QSvgNode *parent, const QImage &image,
               const QRectF &bounds);
+    QSvgImage(QSvgNode *parent, const QByteArray &encodedData,
+              const QString &mimeType, const QSize &imageSize,
+              const QRectF &bounds);
+    ~QSvgImage();
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
 
     const QRectF &bounds() const { return m_bounds; }
-    const QImage &image() const { return m_image; }
+    // decodes the image on first use if it was created from encoded data
+    QImage image() const;
+    // whether the decoded pixels are held, in the node or the image cache
+    bool isDecoded() const;
+    QSize imageSize() const { return m_imageSize; }
+
+    // the compressed bytes the image is decoded from, if known
+    const QByteArray &encodedData() const { return m_encodedData; }
+    const QString &mimeType() const { return m_mimeType; }
 private:
     QImage m_image;
     QRectF m_bounds;
+    QSize m_imageSize;
+    QByteArray m_encodedData;
+    QString m_mimeType;
+    quint64 m_cacheKey;
+    mutable bool m_decodeFailed;
 };
 
 class Q_SVG_PRIVATE_EXPORT QSvgLine : public QSvgNode
@@ -164,7 +181,7 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
 
     const QLineF &line() const { return m_line; }
     const QSvgMarkerUse& Marker() const { return m_markerLink; }
@@ -183,7 +200,7 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     QSvgNode *getFillPattern() override;
     void updateFillPattern(QSvgNode* fillPattern) override;
 
@@ -208,7 +225,7 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     QSvgNode *getFillPattern() override;
     void updateFillPattern(QSvgNode* fillPattern) override;
 
@@ -230,7 +247,7 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     QSvgNode *getFillPattern() override;
     void updateFillPattern(QSvgNode* fillPattern) override;
     const QPolygonF &poly() const { return m_poly; }
@@ -252,7 +269,7 @@ public:
     Type type() const override;
     void draw(QPainter *p, QSvgExtraStates &states) override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     QSvgNode *getFillPattern() override;
     void updateFillPattern(QSvgNode* fillPattern) override;
 
@@ -279,6 +296,7 @@ public:
     QSvgText(QSvgNode *parent, const QPointF &coord);
     QSvgText(const QSvgText &other);
     ~QSvgText();
+    void setDocument(QSvgTinyDocument *doc) override;
     void setTextArea(const QSizeF &size);
     void setCoord(const QPointF &coord) { m_coord = coord; };
     void clearTspans();
@@ -296,7 +314,7 @@ public:
     const QPointF &coord() const { return m_coord; }
     const QSizeF &size() const { return m_size; }
     const QVector<QSvgTspan *> &tspans() const { return m_tspans; }
-    // QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    // QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
 
 private:
     qreal lineWidth(QString graph, QTextLayout::FormatRange formatRange, qreal scale,
@@ -337,6 +355,7 @@ public:
     QSvgTspan(QSvgNode *parent) : QSvgNode(parent), m_mode(QSvgText::Default), m_segments(0){ }
     QSvgTspan(const QSvgTspan &other);
     ~QSvgTspan();
+    void setDocument(QSvgTinyDocument *doc) override;
     Type type() const override { return TSPAN; }
     void draw(QPainter *, QSvgExtraStates &) override { Q_ASSERT(!"Tspans should be drawn through QSvgText::draw()."); }
     QSvgNode *clone(QSvgNode *parent) override;
@@ -388,12 +407,13 @@ public:
     void draw(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
     QSvgNode *clone(QSvgNode *parent) override;
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     bool isResolved() const { return m_link != nullptr; }
     const QString linkId() const
     {
         return m_linkId.isEmpty() && isResolved() ? m_link->nodeId() : m_linkId;
     }
+    QSvgNode *link() const { return m_link; }
     void setLink(QSvgNode *link) { m_link = link; }
     const QPointF &start() const { return m_start; }
 
@@ -53,14 +53,20 @@
 #include "qcolor.h"
 #include "qtextformat.h"
 #include "qvector.h"
+#include "qset.h"
 #include "qfileinfo.h"
 #include "qfile.h"
 #include "qdir.h"
+#include "qbuffer.h"
+#include "qimagereader.h"
 #include "qdebug.h"
 #include "qmath.h"
 #include "qnumeric.h"
 #include <qregularexpression.h>
 #include "qvarlengtharray.h"
+#include "qrunnable.h"
+#include "qsemaphore.h"
+#include "qthreadpool.h"
 #include "private/qmath_p.h"
 
 #include "float.h"
@@ -187,9 +193,22 @@ static inline QString someId(const QXmlStreamAttributes &attributes)
     return id;
 }
 
+// A number or length that a stylesheet already parsed.
+struct QSvgCssLength
+{
+    qreal value = 0;
+    QSvgHandler::LengthType type = QSvgHandler::LT_OTHER;
+    bool unitless = false; // the document's default coordinate system applies
+    bool isSet = false;
+};
+
 struct QSvgAttributes
 {
     QSvgAttributes(const QXmlStreamAttributes &xmlAttributes, QSvgHandler *handler);
+#ifndef QT_NO_CSSPARSER
+    explicit QSvgAttributes(const QVector<QCss::Declaration> &declarations);
+    void setCssAttribute(const QStringRef &name, const QStringRef &value);
+#endif
 
     QString id;
 
@@ -227,122 +246,140 @@ struct QSvgAttributes
     QStringRef stopColor;
     QStringRef stopOpacity;
 
+    // values that a stylesheet already parsed; they take precedence over
+    // the strings of the same properties
+    QColor fillColor;
+    QColor strokeColor;
+    QString fillUrlId;
+    QString strokeUrlId;
+    QSvgCssLength fillOpacityValue;
+    QSvgCssLength strokeOpacityValue;
+    QSvgCssLength strokeWidthValue;
+    QSvgCssLength fontSizeValue;
+    QSvgCssLength opacityValue;
+
 #ifndef QT_NO_CSSPARSER
     QVector<QSvgCssAttribute> m_cssAttributes;
+    QVector<QString> m_cssValues;
 #endif
 };
 
-QSvgAttributes::QSvgAttributes(const QXmlStreamAttributes &xmlAttributes, QSvgHandler *handler)
-{
 #ifndef QT_NO_CSSPARSER
-    QStringRef style = xmlAttributes.value(QLatin1String("style"));
-    if (!style.isEmpty()) {
-        handler->parseCSStoXMLAttrs(style.toString(), &m_cssAttributes);
-        for (int j = 0; j < m_cssAttributes.count(); ++j) {
-            const QSvgCssAttribute &attribute = m_cssAttributes.at(j);
-            QStringRef name = attribute.name;
-            QStringRef value = attribute.value;
-            if (name.isEmpty())
-                continue;
+void QSvgAttributes::setCssAttribute(const QStringRef &name, const QStringRef &value)
+{
+    if (name.isEmpty())
+        return;
 
-            switch (name.at(0).unicode()) {
-
-            case 'c':
-                if (name == QLatin1String("clip-path"))
-                    clipPath = value;
-                else if (name == QLatin1String("clip-rule"))
-                    clipRule = value;
-                else if (name == QLatin1String("color"))
-                    color = value;
-                else if (name == QLatin1String("color-opacity"))
-                    colorOpacity = value;
-                else if (name == QLatin1String("comp-op"))
-                    compOp = value;
-                break;
+    switch (name.at(0).unicode()) {
 
-            case 'd':
-                if (name == QLatin1String("display"))
-                    display = value;
-                break;
+    case 'c':
+        if (name == QLatin1String("clip-path"))
+            clipPath = value;
+        else if (name == QLatin1String("clip-rule"))
+            clipRule = value;
+        else if (name == QLatin1String("color"))
+            color = value;
+        else if (name == QLatin1String("color-opacity"))
+            colorOpacity = value;
+        else if (name == QLatin1String("comp-op"))
+            compOp = value;
+        break;
 
-            case 'f':
-                if (name == QLatin1String("fill"))
-                    fill = value;
-                else if (name == QLatin1String("fill-rule"))
-                    fillRule = value;
-                else if (name == QLatin1String("fill-opacity"))
-                    fillOpacity = value;
-                else if (name == QLatin1String("font-family"))
-                    fontFamily = value;
-                else if (name == QLatin1String("font-size"))
-                    fontSize = value;
-                else if (name == QLatin1String("font-style"))
-                    fontStyle = value;
-                else if (name == QLatin1String("font-weight"))
-                    fontWeight = value;
-                else if (name == QLatin1String("font-variant"))
-                    fontVariant = value;
-                break;
+    case 'd':
+        if (name == QLatin1String("display"))
+            display = value;
+        break;
 
-            case 'm':
-                if (name == QLatin1String("marker-start"))
-                    markerStart = value;
-                else if (name == QLatin1String("marker-mid"))
-                    markerMid = value;
-                else if (name == QLatin1String("marker-end"))
-                    markerEnd = value;
-                break;
+    case 'f':
+        if (name == QLatin1String("fill"))
+            fill = value;
+        else if (name == QLatin1String("fill-rule"))
+            fillRule = value;
+        else if (name == QLatin1String("fill-opacity"))
+            fillOpacity = value;
+        else if (name == QLatin1String("font-family"))
+            fontFamily = value;
+        else if (name == QLatin1String("font-size"))
+            fontSize = value;
+        else if (name == QLatin1String("font-style"))
+            fontStyle = value;
+        else if (name == QLatin1String("font-weight"))
+            fontWeight = value;
+        else if (name == QLatin1String("font-variant"))
+            fontVariant = value;
+        break;
 
-            case 'o':
-                if (name == QLatin1String("opacity"))
-                    opacity = value;
-                else if (name == QLatin1String("offset"))
-                    offset = value;
-                break;
+    case 'm':
+        if (name == QLatin1String("marker-start"))
+            markerStart = value;
+        else if (name == QLatin1String("marker-mid"))
+            markerMid = value;
+        else if (name == QLatin1String("marker-end"))
+            markerEnd = value;
+        break;
 
-            case 's':
-                if (name.length() > 5 && QStringRef(name.string(), name.position() + 1, 5) == QLatin1String("troke")) {
-                    QStringRef strokeRef(name.string(), name.position() + 6, name.length() - 6);
-                    if (strokeRef.isEmpty())
-                        stroke = value;
-                    else if (strokeRef == QLatin1String("-dasharray"))
-                        strokeDashArray = value;
-                    else if (strokeRef == QLatin1String("-dashoffset"))
-                        strokeDashOffset = value;
-                    else if (strokeRef == QLatin1String("-linecap"))
-                        strokeLineCap = value;
-                    else if (strokeRef == QLatin1String("-linejoin"))
-                        strokeLineJoin = value;
-                    else if (strokeRef == QLatin1String("-miterlimit"))
-                        strokeMiterLimit = value;
-                    else if (strokeRef == QLatin1String("-opacity"))
-                        strokeOpacity = value;
-                    else if (strokeRef == QLatin1String("-width"))
-                        strokeWidth = value;
-                }
-                else if (name == QLatin1String("stop-color"))
-                    stopColor = value;
-                else if (name == QLatin1String("stop-opacity"))
-                    stopOpacity = value;
-                break;
+    case 'o':
+        if (name == QLatin1String("opacity"))
+            opacity = value;
+        else if (name == QLatin1String("offset"))
+            offset = value;
+        break;
 
-            case 't':
-                if (name == QLatin1String("text-anchor"))
-                    textAnchor = value;
-                else if (name == QLatin1String("transform"))
-                    transform = value;
-                break;
+    case 's':
+        if (name.length() > 5 && QStringRef(name.string(), name.position() + 1, 5) == QLatin1String("troke")) {
+            QStringRef strokeRef(name.string(), name.position() + 6, name.length() - 6);
+            if (strokeRef.isEmpty())
+                stroke = value;
+            else if (strokeRef == QLatin1String("-dasharray"))
+                strokeDashArray = value;
+            else if (strokeRef == QLatin1String("-dashoffset"))
+                strokeDashOffset = value;
+            else if (strokeRef == QLatin1String("-linecap"))
+                strokeLineCap = value;
+            else if (strokeRef == QLatin1String("-linejoin"))
+                strokeLineJoin = value;
+            else if (strokeRef == QLatin1String("-miterlimit"))
+                strokeMiterLimit = value;
+            else if (strokeRef == QLatin1String("-opacity"))
+                strokeOpacity = value;
+            else if (strokeRef == QLatin1String("-width"))
+                strokeWidth = value;
+        }
+        else if (name == QLatin1String("stop-color"))
+            stopColor = value;
+        else if (name == QLatin1String("stop-opacity"))
+            stopOpacity = value;
+        break;
 
-            case 'v':
-                if (name == QLatin1String("vector-effect"))
-                    vectorEffect = value;
-                else if (name == QLatin1String("visibility"))
-                    visibility = value;
-                break;
+    case 't':
+        if (name == QLatin1String("text-anchor"))
+            textAnchor = value;
+        else if (name == QLatin1String("transform"))
+            transform = value;
+        break;
 
-            default:
-                break;
-           }
+    case 'v':
+        if (name == QLatin1String("vector-effect"))
+            vectorEffect = value;
+        else if (name == QLatin1String("visibility"))
+            visibility = value;
+        break;
+
+    default:
+        break;
+    }
+}
+#endif // QT_NO_CSSPARSER
+
+QSvgAttributes::QSvgAttributes(const QXmlStreamAttributes &xmlAttributes, QSvgHandler *handler)
+{
+#ifndef QT_NO_CSSPARSER
+    QStringRef style = xmlAttributes.value(QLatin1String("style"));
+    if (!style.isEmpty()) {
+        handler->parseCSStoXMLAttrs(style.toString(), &m_cssAttributes);
+        for (int j = 0; j < m_cssAttributes.count(); ++j) {
+            const QSvgCssAttribute &attribute = m_cssAttributes.at(j);
+            setCssAttribute(attribute.name, attribute.value);
         }
     }
 #else
@@ -503,6 +540,7 @@ class QSvgStyleSelector : public QCss::StyleSelector
 {
 public:
     QSvgStyleSelector()
+        : m_hasUniversalRules(false)
     {
         nameCaseSensitivity = Qt::CaseInsensitive;
     }
@@ -510,6 +548,37 @@ public:
     {
     }
 
+    void addStyleSheet(const QCss::StyleSheet &sheet)
+    {
+        styleSheets.append(sheet);
+        for (const QCss::StyleRule &rule : sheet.styleRules) {
+            for (const QCss::Selector &selector : rule.selectors) {
+                if (!selector.basicSelectors.isEmpty())
+                    indexSelector(selector.basicSelectors.last());
+            }
+        }
+    }
+
+    // Returns false if no rule can match \a node, judging by the id, class
+    // and element name of the rightmost compound selector of each rule.
+    bool hasCandidateRules(QSvgNode *node) const
+    {
+        if (m_hasUniversalRules)
+            return true;
+        if (!m_ids.isEmpty() && !node->nodeId().isEmpty() && m_ids.contains(node->nodeId()))
+            return true;
+        if (!m_names.isEmpty() && m_names.contains(nodeToName(node).toLower()))
+            return true;
+        if (!m_classes.isEmpty() && !node->xmlClass().isEmpty()) {
+            const QVector<QStringRef> classes = node->xmlClass().splitRef(QLatin1Char(' '), QString::SkipEmptyParts);
+            for (const QStringRef &xmlClass : classes) {
+                if (m_classes.contains(xmlClass.toString()))
+                    return true;
+            }
+        }
+        return false;
+    }
+
     inline QString nodeToName(QSvgNode *node) const
     {
         return QLatin1String(QSvgStyleSelector_nodeString[node->type()]);
@@ -629,6 +698,42 @@ public:
     {
         Q_UNUSED(node);
     }
+
+private:
+    // Records the narrowest key a node must have to match \a sel; selectors
+    // without one can match any node.
+    void indexSelector(const QCss::BasicSelector &sel)
+    {
+        if (!sel.ids.isEmpty()) {
+            m_ids.insert(sel.ids.first());
+            return;
+        }
+        for (const QCss::AttributeSelector &attr : sel.attributeSelectors) {
+            if (attr.name != QLatin1String("class"))
+                continue;
+            if (attr.valueMatchCriterium == QCss::AttributeSelector::MatchIncludes) {
+                m_classes.insert(attr.value);
+                return;
+            }
+            if (attr.valueMatchCriterium == QCss::AttributeSelector::MatchEqual) {
+                const QStringList classes = attr.value.split(QLatin1Char(' '), QString::SkipEmptyParts);
+                for (const QString &xmlClass : classes)
+                    m_classes.insert(xmlClass);
+                if (!classes.isEmpty())
+                    return;
+            }
+        }
+        if (!sel.elementName.isEmpty() && sel.elementName != QLatin1String("*")) {
+            m_names.insert(sel.elementName.toLower());
+            return;
+        }
+        m_hasUniversalRules = true;
+    }
+
+    QSet<QString> m_ids;
+    QSet<QString> m_classes;
+    QSet<QString> m_names;
+    bool m_hasUniversalRules;
 };
 
 #endif // QT_NO_CSSPARSER
@@ -1096,6 +1201,107 @@ static QSvgStyleProperty *styleFromId(QSvgNode *node, const QString &id)
     return node ? node->styleProperty(id) : 0;
 }
 
+// Style properties remember the painter state they replace, so a shared
+// instance must never be applied while it is already applied. Only plain
+// shapes in rendered groups share; markers, patterns, clip paths and <use>
+// are what draw nodes from within another node.
+static bool canShareStyle(const QSvgNode *node)
+{
+    switch (node->type()) {
+    case QSvgNode::ARC:
+    case QSvgNode::CIRCLE:
+    case QSvgNode::ELLIPSE:
+    case QSvgNode::IMAGE:
+    case QSvgNode::LINE:
+    case QSvgNode::PATH:
+    case QSvgNode::POLYGON:
+    case QSvgNode::POLYLINE:
+    case QSvgNode::RECT:
+        break;
+    default:
+        return false;
+    }
+
+    const QSvgNode *parent = node->parent();
+    return parent && (parent->type() == QSvgNode::DOC
+                      || parent->type() == QSvgNode::G
+                      || parent->type() == QSvgNode::SWITCH);
+}
+
+static void appendColorKey(QVector<qreal> &key, const QBrush &brush)
+{
+    const quint64 rgba = brush.color().rgba64();
+    key << brush.style() << qreal(rgba >> 32) << qreal(rgba & 0xffffffff);
+}
+
+static bool isPlainBrush(const QBrush &brush)
+{
+    return brush.style() == Qt::NoBrush || brush.style() == Qt::SolidPattern;
+}
+
+static bool fillStyleKey(const QSvgFillStyle *fill, QVector<qreal> &key)
+{
+    if (fill->style() || !fill->gradientId().isEmpty() || !fill->patternId().isEmpty()
+        || !fill->isGradientResolved() || !isPlainBrush(fill->qbrush())) {
+        return false;
+    }
+
+    key << QSvgStyleProperty::FILL << fill->isFillSet();
+    appendColorKey(key, fill->qbrush());
+    key << fill->isFillRuleSet() << fill->fillRule()
+        << fill->isFillOpacitySet() << fill->fillOpacity();
+    return true;
+}
+
+static bool strokeStyleKey(const QSvgStrokeStyle *stroke, QVector<qreal> &key)
+{
+    const QPen pen = stroke->stroke();
+    if (stroke->style() || !stroke->gradientId().isEmpty()
+        || !stroke->isGradientResolved() || !isPlainBrush(pen.brush())) {
+        return false;
+    }
+
+    key << QSvgStyleProperty::STROKE << stroke->isStrokeSet();
+    appendColorKey(key, pen.brush());
+    key << pen.style() << pen.isCosmetic()
+        << stroke->isStrokeWidthSet() << pen.widthF()
+        << stroke->isStrokeLineCapSet() << pen.capStyle()
+        << stroke->isStrokeLineJoinSet() << pen.joinStyle()
+        << stroke->isStrokeMiterLimitSet() << pen.miterLimit()
+        << stroke->isStrokeDashOffsetSet() << stroke->strokeDashOffset()
+        << stroke->isStrokeOpacitySet() << stroke->strokeOpacity()
+        << stroke->isVectorEffectSet() << stroke->vectorEffect()
+        << stroke->isStrokeDashArraySet();
+    if (pen.style() == Qt::CustomDashLine)
+        key << pen.dashPattern();
+    return true;
+}
+
+// Returns an existing property equal to \a prop, which is then deleted, or
+// registers \a prop for the nodes that follow.
+QSvgStyleProperty *QSvgHandler::sharedStyleProperty(QSvgNode *node, QSvgStyleProperty *prop)
+{
+    if (!canShareStyle(node))
+        return prop;
+
+    QVector<qreal> key;
+    bool shareable = false;
+    if (prop->type() == QSvgStyleProperty::FILL)
+        shareable = fillStyleKey(static_cast<QSvgFillStyle *>(prop), key);
+    else if (prop->type() == QSvgStyleProperty::STROKE)
+        shareable = strokeStyleKey(static_cast<QSvgStrokeStyle *>(prop), key);
+    if (!shareable)
+        return prop;
+
+    const auto it = m_sharedStyles.constFind(key);
+    if (it != m_sharedStyles.constEnd()) {
+        delete prop;
+        return *it;
+    }
+    m_sharedStyles.insert(key, prop);
+    return prop;
+}
+
 static void parseBrush(QSvgNode *node,
                        const QSvgAttributes &attributes,
                        QSvgHandler *handler)
@@ -1113,18 +1319,23 @@ static void parseBrush(QSvgNode *node,
 
         //fill-opacity atttribute handling
         if (!attributes.fillOpacity.isEmpty() && attributes.fillOpacity != QT_INHERIT) {
-            bool ok = false;
-            qreal opacity = toDouble(attributes.fillOpacity, &ok);
+            bool ok = attributes.fillOpacityValue.isSet;
+            qreal opacity = attributes.fillOpacityValue.value;
+            if (!ok)
+                opacity = toDouble(attributes.fillOpacity, &ok);
             if (ok)
                 prop->setFillOpacity(qMin(qreal(1.0), qMax(qreal(0.0), opacity)));
         }
 
         //fill attribute handling
         if ((!attributes.fill.isEmpty()) && (attributes.fill != QT_INHERIT) ) {
-            if (attributes.fill.length() > 3 &&
-                QStringRef(attributes.fill.string(), attributes.fill.position(), 3) == QLatin1String("url")) {
-                QStringRef urlRef(attributes.fill.string(), attributes.fill.position() + 3, attributes.fill.length() - 3);
-                QString id = idFromUrl(urlRef.toString());
+            if (!attributes.fillUrlId.isEmpty() || (attributes.fill.length() > 3 &&
+                QStringRef(attributes.fill.string(), attributes.fill.position(), 3) == QLatin1String("url"))) {
+                QString id = attributes.fillUrlId;
+                if (id.isEmpty()) {
+                    QStringRef urlRef(attributes.fill.string(), attributes.fill.position() + 3, attributes.fill.length() - 3);
+                    id = idFromUrl(urlRef.toString());
+                }
 
                 QSvgNode *namedNode = handler->document()->namedNode(id);
                 if (namedNode && namedNode->type() == QSvgNode::PATTERN){
@@ -1140,6 +1351,8 @@ static void parseBrush(QSvgNode *node,
                         prop->setGradientResolved(false);
                     }  
                 }
+            } else if (attributes.fillColor.isValid()) {
+                prop->setBrush(QBrush(attributes.fillColor));
             } else if (attributes.fill != QLatin1String("none")) {
                 QColor color;
                 if (resolveColor(attributes.fill, color, handler))
@@ -1148,7 +1361,7 @@ static void parseBrush(QSvgNode *node,
                 prop->setBrush(QBrush(Qt::NoBrush));
             }
         }
-        node->appendStyleProperty(prop, attributes.id);
+        node->appendStyleProperty(handler->sharedStyleProperty(node, prop), attributes.id);
     }
 }
 
@@ -1300,10 +1513,13 @@ static void parsePen(QSvgNode *node,
 
         //stroke attribute handling
         if ((!attributes.stroke.isEmpty()) && (attributes.stroke != QT_INHERIT) ) {
-            if (attributes.stroke.length() > 3 &&
-                 QStringRef(attributes.stroke.string(), attributes.stroke.position(), 3) == QLatin1String("url")) {
-                 QStringRef urlRef(attributes.stroke.string(), attributes.stroke.position() + 3, attributes.stroke.length() - 3);
-                 QString id = idFromUrl(urlRef.toString());
+            if (!attributes.strokeUrlId.isEmpty() || (attributes.stroke.length() > 3 &&
+                 QStringRef(attributes.stroke.string(), attributes.stroke.position(), 3) == QLatin1String("url"))) {
+                 QString id = attributes.strokeUrlId;
+                 if (id.isEmpty()) {
+                     QStringRef urlRef(attributes.stroke.string(), attributes.stroke.position() + 3, attributes.stroke.length() - 3);
+                     id = idFromUrl(urlRef.toString());
+                 }
                  prop->setGradientId(id);
                  QSvgStyleProperty *style = styleFromId(node, id);
                  if (style) {
@@ -1313,6 +1529,8 @@ static void parsePen(QSvgNode *node,
                  } else {
                      prop->setGradientResolved(false);
                  }
+            } else if (attributes.strokeColor.isValid()) {
+                prop->setStroke(QBrush(attributes.strokeColor));
             } else if (attributes.stroke != QLatin1String("none")) {
                 QColor color;
                 if (resolveColor(attributes.stroke, color, handler))
@@ -1325,7 +1543,14 @@ static void parsePen(QSvgNode *node,
         //stroke-width handling
         if (!attributes.strokeWidth.isEmpty() && attributes.strokeWidth != QT_INHERIT) {
             QSvgHandler::LengthType lt;
-            qreal strokeWidth = parseLength(attributes.strokeWidth.toString(), lt, handler);
+            qreal strokeWidth;
+            if (attributes.strokeWidthValue.isSet) {
+                strokeWidth = attributes.strokeWidthValue.value;
+                lt = attributes.strokeWidthValue.unitless ? handler->defaultCoordinateSystem()
+                                                          : attributes.strokeWidthValue.type;
+            } else {
+                strokeWidth = parseLength(attributes.strokeWidth.toString(), lt, handler);
+            }
             strokeWidth = convertToPixels(strokeWidth, true, lt);
             if (strokeWidth > 10000.0 || strokeWidth < 0) // 10000 from ie & edge
                 strokeWidth = 0;
@@ -1385,13 +1610,15 @@ static void parsePen(QSvgNode *node,
 
         //stroke-opacity atttribute handling
         if (!attributes.strokeOpacity.isEmpty() && attributes.strokeOpacity != QT_INHERIT) {
-            bool ok = false;
-            qreal opacity = toDouble(attributes.strokeOpacity, &ok);
+            bool ok = attributes.strokeOpacityValue.isSet;
+            qreal opacity = attributes.strokeOpacityValue.value;
+            if (!ok)
+                opacity = toDouble(attributes.strokeOpacity, &ok);
             if (ok)
                 prop->setOpacity(qMin(qreal(1.0), qMax(qreal(0.0), opacity)));
         }
 
-        node->appendStyleProperty(prop, attributes.id);
+        node->appendStyleProperty(handler->sharedStyleProperty(node, prop), attributes.id);
     }
 }
 
@@ -1461,13 +1688,21 @@ static void parseFont(QSvgNode *node,
 
     if (!attributes.fontSize.isEmpty() && attributes.fontSize != QT_INHERIT) {
         // TODO: Support relative sizes 'larger' and 'smaller'.
-        const FontSizeSpec spec = fontSizeSpec(attributes.fontSize);
+        const FontSizeSpec spec = attributes.fontSizeValue.isSet ? FontSizeValue
+                                                                 : fontSizeSpec(attributes.fontSize);
         switch (spec) {
         case FontSizeNone:
             break;
         case FontSizeValue: {
             QSvgHandler::LengthType dummy; // should always be pixel size
-            qreal fontPixelSizeStored = parseLength(attributes.fontSize, dummy, handler);
+            qreal fontPixelSizeStored;
+            if (attributes.fontSizeValue.isSet) {
+                fontPixelSizeStored = attributes.fontSizeValue.value;
+                dummy = attributes.fontSizeValue.unitless ? handler->defaultCoordinateSystem()
+                                                          : attributes.fontSizeValue.type;
+            } else {
+                fontPixelSizeStored = parseLength(attributes.fontSize, dummy, handler);
+            }
 
             if (QSvgHandler::LT_PERCENT == dummy)
             {
@@ -2049,49 +2284,167 @@ static bool parseStyle(QSvgNode *node,
 
 #ifndef QT_NO_CSSPARSER
 
-static void parseCSStoXMLAttrs(const QVector<QCss::Declaration> &declarations,
-                               QXmlStreamAttributes &attributes)
+static QString cssValueToString(const QCss::Declaration &decl)
 {
-    for (int i = 0; i < declarations.count(); ++i) {
-        const QCss::Declaration &decl = declarations.at(i);
-        if (decl.d->property.isEmpty())
-            continue;
-        QCss::Value val = decl.d->values.first();
-        QString valueStr;
-        const int valCount = decl.d->values.count();
-        if (valCount != 1) {
-            for (int i = 0; i < valCount; ++i) {
-                valueStr += decl.d->values[i].toString();
-                if (i + 1 < valCount)
-                    valueStr += QLatin1Char(',');
+    const QCss::Value &val = decl.d->values.first();
+    QString valueStr;
+    const int valCount = decl.d->values.count();
+    if (valCount != 1) {
+        for (int i = 0; i < valCount; ++i) {
+            valueStr += decl.d->values[i].toString();
+            if (i + 1 < valCount)
+                valueStr += QLatin1Char(',');
+        }
+    } else {
+        valueStr = val.toString();
+    }
+    if (val.type == QCss::Value::Uri) {
+        valueStr.prepend(QLatin1String("url("));
+        valueStr.append(QLatin1Char(')'));
+    } else if (val.type == QCss::Value::Function) {
+        QStringList lst = val.variant.toStringList();
+        valueStr.append(lst.at(0));
+        valueStr.append(QLatin1Char('('));
+        for (int i = 1; i < lst.count(); ++i) {
+            valueStr.append(lst.at(i));
+            if ((i +1) < lst.count())
+                valueStr.append(QLatin1Char(','));
+        }
+        valueStr.append(QLatin1Char(')'));
+    } else if (val.type == QCss::Value::KnownIdentifier) {
+        switch (val.variant.toInt()) {
+        case QCss::Value_None:
+            valueStr = QLatin1String("none");
+            break;
+        default:
+            break;
+        }
+    }
+    return valueStr;
+}
+
+// Reads a number, percentage or length with a unit parseLength() knows.
+static bool cssLengthValue(const QCss::Value &val, QSvgCssLength *length)
+{
+    static const struct {
+        char unit[3];
+        QSvgHandler::LengthType type;
+    } units[] = {
+        { "px", QSvgHandler::LT_PX }, { "pc", QSvgHandler::LT_PC },
+        { "pt", QSvgHandler::LT_PT }, { "mm", QSvgHandler::LT_MM },
+        { "cm", QSvgHandler::LT_CM }, { "in", QSvgHandler::LT_IN },
+        { "em", QSvgHandler::LT_EM }
+    };
+
+    bool ok = false;
+    switch (val.type) {
+    case QCss::Value::Number:
+        length->value = val.variant.toDouble(&ok);
+        length->unitless = true;
+        break;
+    case QCss::Value::Percentage: // the parser already dropped the '%'
+        length->value = toDouble(val.variant.toString(), &ok);
+        length->type = QSvgHandler::LT_PERCENT;
+        break;
+    case QCss::Value::Length: {
+        const QString str = val.variant.toString();
+        for (const auto &unit : units) {
+            if (str.endsWith(QLatin1String(unit.unit))) {
+                length->value = toDouble(str.leftRef(str.length() - 2), &ok);
+                length->type = unit.type;
+                break;
             }
-        } else {
-            valueStr = val.toString();
         }
-        if (val.type == QCss::Value::Uri) {
-            valueStr.prepend(QLatin1String("url("));
-            valueStr.append(QLatin1Char(')'));
-        } else if (val.type == QCss::Value::Function) {
-            QStringList lst = val.variant.toStringList();
-            valueStr.append(lst.at(0));
-            valueStr.append(QLatin1Char('('));
-            for (int i = 1; i < lst.count(); ++i) {
-                valueStr.append(lst.at(i));
-                if ((i +1) < lst.count())
-                    valueStr.append(QLatin1Char(','));
+        break;
+    }
+    default:
+        break;
+    }
+    length->isSet = ok;
+    return ok;
+}
+
+// Maps the declarations matched by the style selector straight onto the
+// attribute slots. Colours, url() references, numbers and lengths keep the
+// values the CSS parser produced instead of being printed and parsed again.
+QSvgAttributes::QSvgAttributes(const QVector<QCss::Declaration> &declarations)
+{
+    // marks a slot whose value is held in one of the typed members
+    static const QString typedValue(QLatin1Char('#'));
+
+    // the attribute slots point into this vector, so it must not reallocate
+    m_cssValues.reserve(declarations.count());
+    for (const QCss::Declaration &decl : declarations) {
+        const QString &name = decl.d->property;
+        if (name.isEmpty() || decl.d->values.isEmpty())
+            continue;
+
+        const QCss::Value &val = decl.d->values.first();
+        const bool single = decl.d->values.count() == 1;
+
+        // a later declaration replaces an earlier typed value
+        QStringRef *slot = nullptr;
+        QSvgCssLength *number = nullptr;
+        bool isOpacity = false;
+        QColor *color = nullptr;
+        QString *urlId = nullptr;
+        if (name == QLatin1String("fill")) {
+            slot = &fill;
+            color = &fillColor;
+            urlId = &fillUrlId;
+        } else if (name == QLatin1String("stroke")) {
+            slot = &stroke;
+            color = &strokeColor;
+            urlId = &strokeUrlId;
+        } else if (name == QLatin1String("stroke-width")) {
+            slot = &strokeWidth;
+            number = &strokeWidthValue;
+        } else if (name == QLatin1String("font-size")) {
+            slot = &fontSize;
+            number = &fontSizeValue;
+        } else if (name == QLatin1String("fill-opacity")) {
+            slot = &fillOpacity;
+            number = &fillOpacityValue;
+            isOpacity = true;
+        } else if (name == QLatin1String("stroke-opacity")) {
+            slot = &strokeOpacity;
+            number = &strokeOpacityValue;
+            isOpacity = true;
+        } else if (name == QLatin1String("opacity")) {
+            slot = &opacity;
+            number = &opacityValue;
+            isOpacity = true;
+        }
+
+        if (color) {
+            *color = QColor();
+            urlId->clear();
+            if (single && val.type == QCss::Value::Color) {
+                // as before, only the rgb part of the colour is used
+                *color = QColor(qvariant_cast<QColor>(val.variant).rgb());
+                *slot = QStringRef(&typedValue);
+                continue;
             }
-            valueStr.append(QLatin1Char(')'));
-        } else if (val.type == QCss::Value::KnownIdentifier) {
-            switch (val.variant.toInt()) {
-            case QCss::Value_None:
-                valueStr = QLatin1String("none");
-                break;
-            default:
-                break;
+            if (single && val.type == QCss::Value::Uri) {
+                const QString url = val.variant.toString().trimmed();
+                if (url.startsWith(QLatin1Char('#')) && url.length() > 1) {
+                    *urlId = url.mid(1);
+                    *slot = QStringRef(&typedValue);
+                    continue;
+                }
             }
+        } else if (number) {
+            *number = QSvgCssLength();
+            if (single && (!isOpacity || val.type == QCss::Value::Number)
+                    && cssLengthValue(val, number)) {
+                *slot = QStringRef(&typedValue);
+                continue;
+            }
+            *number = QSvgCssLength();
         }
 
-        attributes.append(QString(), decl.d->property, valueStr);
+        m_cssValues.append(cssValueToString(decl));
+        setCssAttribute(QStringRef(&name), QStringRef(&m_cssValues.last()));
     }
 }
 
@@ -2171,13 +2524,14 @@ static void cssStyleLookup(QSvgNode *node,
                            QSvgHandler *handler,
                            QSvgStyleSelector *selector)
 {
+    if (selector->styleSheets.isEmpty() || !selector->hasCandidateRules(node))
+        return;
+
     QCss::StyleSelector::NodePtr cssNode;
     cssNode.ptr = node;
-    QVector<QCss::Declaration> decls = selector->declarationsForNode(cssNode);
-
-    QXmlStreamAttributes attributes;
-    parseCSStoXMLAttrs(decls, attributes);
-    parseStyle(node, attributes, handler);
+    const QVector<QCss::Declaration> decls = selector->declarationsForNode(cssNode);
+    if (!decls.isEmpty())
+        parseStyle(node, QSvgAttributes(decls), handler);
 }
 
 #endif // QT_NO_CSSPARSER
@@ -2246,10 +2600,10 @@ static void parseOpacity(QSvgNode *node,
     if (attributes.opacity.isEmpty())
         return;
 
-    const QStringRef value = attributes.opacity.trimmed();
-
-    bool ok = false;
-    qreal op = value.toDouble(&ok);
+    bool ok = attributes.opacityValue.isSet;
+    qreal op = attributes.opacityValue.value;
+    if (!ok)
+        op = attributes.opacity.trimmed().toDouble(&ok);
 
     if (ok) {
         QSvgOpacityStyle *opacity = new QSvgOpacityStyle(qBound(qreal(0.0), op, qreal(1.0)));
@@ -2526,6 +2880,21 @@ static bool parseAnimateNode(QSvgNode *parent,
     return true;
 }
 
+static void markAnimated(QSvgNode *node)
+{
+    node->markSubtreeAnimated();
+
+    // Markers, clip paths and patterns are drawn through the style of other
+    // nodes, so those users can't be told apart from static content.
+    for (QSvgNode *n = node; n; n = n->parent()) {
+        const QSvgNode::Type t = n->type();
+        if (t == QSvgNode::MARKER || t == QSvgNode::CLIPPATH || t == QSvgNode::PATTERN) {
+            node->document()->setStaticLayersEnabled(false);
+            break;
+        }
+    }
+}
+
 static bool parseAnimateColorNode(QSvgNode *parent,
                                   const QXmlStreamAttributes &attributes,
                                   QSvgHandler *handler)
@@ -2586,6 +2955,7 @@ static bool parseAnimateColorNode(QSvgNode *parent,
 
     parent->appendStyleProperty(anim, someId(attributes));
     parent->document()->setAnimated(true);
+    markAnimated(parent);
     handler->setAnimPeriod(begin, end);
     return true;
 }
@@ -2708,6 +3078,7 @@ static bool parseAnimateTransformNode(QSvgNode *parent,
 
     parent->appendStyleProperty(anim, someId(attributes));
     parent->document()->setAnimated(true);
+    markAnimated(parent);
     handler->setAnimPeriod(begin, end);
     return true;
 }
@@ -3140,10 +3511,32 @@ static QSvgNode *createImageNode(QSvgNode *parent,
     if (filename.startsWith(QLatin1String("data"))) {
         int idx = filename.lastIndexOf(QLatin1String("base64,"));
         if (idx != -1) {
+            QString mimeType;
+            if (filename.startsWith(QLatin1String("data:image/"))) {
+                const int end = filename.indexOf(QLatin1Char(';'), 5);
+                if (end != -1 && end < idx)
+                    mimeType = filename.mid(5, end - 5).trimmed().toLower();
+            }
             idx += 7;
             const QString dataStr = filename.mid(idx);
             QByteArray data = QByteArray::fromBase64(dataStr.toLatin1());
-            image = QImage::fromData(data);
+
+            // Only the header is read here, the pixels are decoded when
+            // the image is first used. A payload that is corrupt past its
+            // header is reported then.
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::ReadOnly);
+            QImageReader reader(&buffer);
+            const QSize size = reader.canRead() ? reader.size() : QSize();
+            buffer.close();
+            if (size.isEmpty()) {
+                qCWarning(lcSvgHandler) << "Could not create image from" << filename.left(idx);
+                return 0;
+            }
+            if (mimeType.isEmpty())
+                mimeType = QLatin1String("image/") + QString::fromLatin1(reader.format());
+            return new QSvgImage(parent, data, mimeType, size,
+                                 QRectF(nx, ny, nwidth, nheight));
         } else {
             qCDebug(lcSvgHandler) << "QSvgHandler::createImageNode: Unrecognized inline image format!";
         }
@@ -3322,14 +3715,23 @@ static bool parseMpathNode(QSvgNode *parent,
     return true;
 }
 
+// path data at least this long is parsed after the structure, in parallel
+static const int qsvg_deferredPathLength = 256;
+
 static QSvgNode *createPathNode(QSvgNode *parent,
                                 const QXmlStreamAttributes &attributes,
-                                QSvgHandler *)
+                                QSvgHandler *handler)
 {
     QStringRef data      = attributes.value(QLatin1String("d"));
 
     QPainterPath qpath;
     qpath.setFillRule(Qt::WindingFill);
+    if (handler && data.length() >= qsvg_deferredPathLength) {
+        QSvgPath *path = new QSvgPath(parent, qpath);
+        handler->deferPathData(path, data);
+        return path;
+    }
+
     if (!parsePathDataFast(data, qpath))
         qCWarning(lcSvgHandler, "Invalid path data; path truncated.");
 
@@ -4126,9 +4528,95 @@ void QSvgHandler::parse()
             break;
         }
     }
-    resolveGradients(m_doc);
-    resolveNodes();
-    setClipStyleNode(m_doc);
+    parseDeferredPaths();
+    resolveReferences();
+}
+
+void QSvgHandler::deferPathData(QSvgPath *path, const QStringRef &data)
+{
+    m_pendingPath = QSvgDeferredPath(path, data.toString());
+}
+
+static void parseDeferredPath(const QSvgDeferredPath &deferred)
+{
+    QPainterPath *qpath = deferred.node->qpath();
+    if (!parsePathDataFast(QStringRef(&deferred.data), *qpath))
+        qCWarning(lcSvgHandler, "Invalid path data; path truncated.");
+}
+
+// Takes deferred paths off a shared counter until none are left, so the
+// work balances itself however long the individual paths are.
+class QSvgPathDataTask : public QRunnable
+{
+public:
+    QSvgPathDataTask(const QVector<QSvgDeferredPath> &paths, QAtomicInt &next)
+        : m_paths(paths), m_next(next)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        parseRemaining(m_paths, m_next);
+        m_done.release();
+    }
+
+    void wait()
+    {
+        if (!QThreadPool::globalInstance()->tryTake(this))
+            m_done.acquire();
+    }
+
+    static void parseRemaining(const QVector<QSvgDeferredPath> &paths, QAtomicInt &next)
+    {
+        for (int i = next.fetchAndAddRelaxed(1); i < paths.size(); i = next.fetchAndAddRelaxed(1))
+            parseDeferredPath(paths.at(i));
+    }
+
+private:
+    const QVector<QSvgDeferredPath> &m_paths;
+    QAtomicInt &m_next;
+    QSemaphore m_done;
+};
+
+// The second phase of parsing: the path data of long paths is parsed once
+// the tree is built, spread over the global thread pool. The nodes are
+// independent, so each one is written by exactly one thread.
+void QSvgHandler::parseDeferredPaths()
+{
+    if (m_deferredPaths.isEmpty())
+        return;
+
+    qint64 length = 0;
+    for (const QSvgDeferredPath &deferred : qAsConst(m_deferredPaths))
+        length += deferred.data.size();
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int threads = qMin(pool->maxThreadCount(), m_deferredPaths.size()) - 1;
+    QAtomicInt next(0);
+    if (threads > 0 && length >= 64 * 1024) {
+        QVector<QSvgPathDataTask *> tasks;
+        tasks.reserve(threads);
+        for (int i = 0; i < threads; ++i) {
+            tasks.append(new QSvgPathDataTask(m_deferredPaths, next));
+            pool->start(tasks.last());
+        }
+        QSvgPathDataTask::parseRemaining(m_deferredPaths, next);
+        for (QSvgPathDataTask *task : qAsConst(tasks)) {
+            task->wait();
+            delete task;
+        }
+    } else {
+        QSvgPathDataTask::parseRemaining(m_deferredPaths, next);
+    }
+
+    // markers were placed on the empty paths while parsing
+    for (const QSvgDeferredPath &deferred : qAsConst(m_deferredPaths)) {
+        const QSvgMarkerUse &markers = deferred.node->Marker();
+        if (markers.start || markers.mid || markers.end)
+            deferred.node->updateMarker();
+    }
+    m_deferredPaths.clear();
 }
 
 void QSvgHandler::modifyCss(QString &css)
@@ -4248,9 +4736,8 @@ bool QSvgHandler::startElement(const QString &localName,
             cssStyleLookup(node, this, m_selector);
 #endif
             parseStyle(node, attributes, this);
-            if (!node->xmlClass().isEmpty()) {
-                m_xmlClasses.append(node->xmlClass());
-            }
+            if (!node->xmlClass().isEmpty())
+                addXmlClass(node->xmlClass());
         }
     } else if (FactoryMethod method = findGraphicsFactory(localName)) {
         //rendering element
@@ -4319,6 +4806,14 @@ bool QSvgHandler::startElement(const QString &localName,
                 break;
             }
 
+            // a path whose data waits for parseDeferredPaths() is only
+            // queued once it is part of the tree
+            if (m_pendingPath.node) {
+                if (node == m_pendingPath.node)
+                    m_deferredPaths.append(m_pendingPath);
+                m_pendingPath = QSvgDeferredPath();
+            }
+
             if (node) {
                 parseCoreNode(node, attributes);
 #ifndef QT_NO_CSSPARSER
@@ -4333,9 +4828,8 @@ bool QSvgHandler::startElement(const QString &localName,
                     if (!static_cast<QSvgUse *>(node)->isResolved())
                         m_resolveNodes.append(node);
                 }
-                if (!node->xmlClass().isEmpty()) {
-                    m_xmlClasses.append(node->xmlClass());
-                }
+                if (!node->xmlClass().isEmpty())
+                    addXmlClass(node->xmlClass());
             }
         }
     } else if (ParseMethod method = findUtilFactory(localName)) {
@@ -4399,26 +4893,68 @@ bool QSvgHandler::endElement(const QStringRef &localName)
     return true;
 }
 
-void QSvgHandler::resolveGradients(QSvgNode *node, int nestedDepth)
+static bool isResolvedContainer(QSvgNode::Type type)
+{
+    return type == QSvgNode::DOC || type == QSvgNode::G || type == QSvgNode::DEFS
+        || type == QSvgNode::SWITCH || type == QSvgNode::MARKER
+        || type == QSvgNode::CLIPPATH || type == QSvgNode::PATTERN;
+}
+
+namespace {
+struct QSvgResolveFrame
+{
+    QSvgStructureNode *node;
+    int next;
+    // what the children inherit, styleProperty() stops at defs and clip paths
+    QSvgFillStyle *fill;
+    QSvgStrokeStyle *stroke;
+    bool inPattern;
+};
+}
+
+// Resolves paint server references, collects clip paths and <use> nodes in a
+// single walk. The inherited fill and stroke travel on the stack instead of
+// being looked up through the parents of every node.
+void QSvgHandler::resolveReferences()
 {
-    if (!node || (node->type() != QSvgNode::DOC && node->type() != QSvgNode::G
-        && node->type() != QSvgNode::DEFS && node->type() != QSvgNode::SWITCH
-        && node->type() != QSvgNode::MARKER && node->type() != QSvgNode::CLIPPATH
-        && node->type() != QSvgNode::PATTERN)){
+    if (!m_doc)
         return;
-    }
 
-    QSvgStructureNode *structureNode = static_cast<QSvgStructureNode *>(node);
+    QVector<QPair<QSvgNode *, QSvgClipPathStyle *> > clipNodes;
+    QVector<const QSvgNode *> openClipPaths;
+    QVector<QSvgUse *> uses;
+    const bool collectUses = m_doc->animated();
+
+    QVector<QSvgResolveFrame> stack;
+    stack.append({ m_doc, 0, m_doc->style().fill, m_doc->style().stroke, false });
+
+    while (!stack.isEmpty()) {
+        QSvgResolveFrame &frame = stack.last();
+        const QList<QSvgNode *> &ren = frame.node->renderers();
+        if (frame.next >= ren.size()) {
+            if (frame.node->type() == QSvgNode::CLIPPATH)
+                openClipPaths.removeLast();
+            stack.removeLast();
+            continue;
+        }
+
+        QSvgNode *child = ren.at(frame.next++);
+        const QSvgNode::Type type = child->type();
+        const bool inPattern = frame.inPattern;
+
+        QSvgFillStyle *fill = child->style().fill;
+        if (!fill && type != QSvgNode::DEFS && type != QSvgNode::CLIPPATH)
+            fill = frame.fill;
+        QSvgStrokeStyle *stroke = child->style().stroke;
+        if (!stroke && type != QSvgNode::DEFS && type != QSvgNode::CLIPPATH)
+            stroke = frame.stroke;
 
-    const QList<QSvgNode *> ren = structureNode->renderers();
-    for (auto it = ren.cbegin(); it != ren.cend(); ++it) {
-        QSvgFillStyle *fill = static_cast<QSvgFillStyle *>((*it)->styleProperty(QSvgStyleProperty::FILL));
         if (fill && !fill->isGradientResolved()) {
             QString id = fill->gradientId();
-            QSvgFillStyleProperty *style = structureNode->styleProperty(id);
+            QSvgFillStyleProperty *style = m_doc->namedStyle(id);
             QSvgNode *pattern = m_doc->namedNode(id);
             if (pattern && pattern->type() == QSvgNode::PATTERN) {
-                (*it)->updateFillPattern(pattern);
+                child->updateFillPattern(pattern);
                 fill->setPatternId(id);
             } else if (style) {
                 fill->setFillStyle(style);
@@ -4428,10 +4964,9 @@ void QSvgHandler::resolveGradients(QSvgNode *node, int nestedDepth)
             }
         }
 
-        QSvgStrokeStyle *stroke = static_cast<QSvgStrokeStyle *>((*it)->styleProperty(QSvgStyleProperty::STROKE));
         if (stroke && !stroke->isGradientResolved()) {
             QString id = stroke->gradientId();
-            QSvgFillStyleProperty *style = structureNode->styleProperty(id);
+            QSvgFillStyleProperty *style = m_doc->namedStyle(id);
             if (style) {
                 stroke->setStyle(style);
             } else {
@@ -4440,9 +4975,37 @@ void QSvgHandler::resolveGradients(QSvgNode *node, int nestedDepth)
             }
         }
 
-        if (nestedDepth < 2048)
-            resolveGradients(*it, nestedDepth + 1);
+        if (!inPattern) {
+            if (QSvgClipPathStyle *clipStyle = child->style().clipPath) {
+                // a clip path does not apply to its own content
+                QSvgNode *clipNode = m_doc->namedNode(clipStyle->clipPathId());
+                if (clipNode && clipNode->type() == QSvgNode::CLIPPATH
+                    && !openClipPaths.contains(clipNode)) {
+                    clipStyle->setClipPathNode(static_cast<QSvgClipPath *>(clipNode));
+                }
+                clipNodes.append(qMakePair(child, clipStyle));
+            }
+            if (collectUses && type == QSvgNode::USE && !child->isSubtreeAnimated())
+                uses.append(static_cast<QSvgUse *>(child));
+        }
+
+        if (isResolvedContainer(type)) {
+            if (type == QSvgNode::CLIPPATH)
+                openClipPaths.append(child);
+            stack.append({ static_cast<QSvgStructureNode *>(child), 0, fill, stroke,
+                           inPattern || type == QSvgNode::PATTERN });
+        }
     }
+
+    resolveNodes();
+    m_doc->computeStyles();
+
+    // bounds may depend on links and on strokes further down, so the clip
+    // paths are only built once everything else is resolved
+    for (const auto &clip : qAsConst(clipNodes))
+        clip.second->initCurrePath(clip.first->transformedBounds());
+
+    markAnimatedUses(uses);
 }
 
 void QSvgHandler::resolveNodes()
@@ -4472,38 +5035,23 @@ void QSvgHandler::resolveNodes()
     m_resolveNodes.clear();
 }
 
-void EnumSvgNode(QSvgNode *node, std::function<void(QSvgNode *node)> callback) 
-{
-    if (!node
-        || (QSvgNode::DOC != node->type() && QSvgNode::G != node->type()
-            && QSvgNode::DEFS != node->type() && QSvgNode::SWITCH != node->type()
-            && QSvgNode::MARKER != node->type() && QSvgNode::CLIPPATH != node->type()))
-        return;
-
-    QSvgStructureNode *structureNode = static_cast<QSvgStructureNode *>(node);
-
-    QList<QSvgNode *> ren = structureNode->renderers();
-    for (auto it = ren.cbegin(); it != ren.cend(); ++it) {
-        QSvgNode *curNode = *it;
-        callback(curNode);
-        
-        if (QSvgNode::DOC == curNode->type() || QSvgNode::G == curNode->type()
-            || QSvgNode::DEFS == curNode->type() || QSvgNode::SWITCH == curNode->type()
-            || QSvgNode::MARKER == curNode->type() || QSvgNode::CLIPPATH == curNode->type())
-            EnumSvgNode(curNode, callback);
-    }
-}
-
-void QSvgHandler::setClipStyleNode(QSvgNode* node)
+// A <use> is only static if what it references is, which is known once all
+// links are resolved.
+void QSvgHandler::markAnimatedUses(const QVector<QSvgUse *> &uses)
 {
-    EnumSvgNode(node, [](QSvgNode *curNode) {
-        QSvgClipPathStyle *clipStyle = 
-            static_cast<QSvgClipPathStyle *>(curNode->styleProperty(QSvgStyleProperty::CLIPPATH));
-        if (clipStyle) {
-            clipStyle->setClipPathNode(curNode);
-            clipStyle->initCurrePath(curNode->transformedBounds());
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (QSvgUse *use : qAsConst(uses)) {
+            if (use->isSubtreeAnimated())
+                continue;
+            QSvgNode *link = use->isResolved() ? use->link() : m_doc->namedNode(use->linkId());
+            if (link && link->isSubtreeAnimated()) {
+                use->markSubtreeAnimated();
+                changed = true;
+            }
         }
-    });
+    }
 }
 
 bool QSvgHandler::characters(const QStringRef &str)
@@ -4515,7 +5063,7 @@ bool QSvgHandler::characters(const QStringRef &str)
             modifyCss(css);
         QCss::StyleSheet sheet;
         QCss::Parser(css).parse(&sheet);
-        m_selector->styleSheets.append(sheet);
+        m_selector->addStyleSheet(sheet);
         return true;
     }
 #endif
@@ -4638,7 +5186,7 @@ bool QSvgHandler::processingInstruction(const QString &target, const QString &da
 
                 QCss::StyleSheet sheet;
                 QCss::Parser(css).parse(&sheet);
-                m_selector->styleSheets.append(sheet);
+                m_selector->addStyleSheet(sheet);
             }
 
         }
@@ -4648,6 +5196,14 @@ bool QSvgHandler::processingInstruction(const QString &target, const QString &da
     return true;
 }
 
+void QSvgHandler::addXmlClass(const QString &xmlClass)
+{
+    if (!m_xmlClassSet.contains(xmlClass)) {
+        m_xmlClassSet.insert(xmlClass);
+        m_xmlClasses.append(xmlClass);
+    }
+}
+
 void QSvgHandler::setAnimPeriod(int start, int end)
 {
     Q_UNUSED(start);
@@ -54,6 +54,7 @@
 #include "QtCore/qxmlstream.h"
 #include "QtCore/qhash.h"
 #include "QtCore/qstack.h"
+#include "QtCore/qset.h"
 #include <QtCore/QLoggingCategory>
 #include "qsvgstyle_p.h"
 #include "private/qcssparser_p.h"
@@ -64,6 +65,7 @@ QT_BEGIN_NAMESPACE
 
 class QSvgNode;
 class QSvgTinyDocument;
+class QSvgUse;
 class QSvgHandler;
 class QColor;
 class QSvgStyleSelector;
@@ -79,6 +81,18 @@ struct QSvgCssAttribute
 
 #endif
 
+// A long "d" attribute whose parsing waits until the document structure is
+// complete, so that all of them can be parsed in parallel.
+struct QSvgDeferredPath
+{
+    QSvgDeferredPath() : node(nullptr) {}
+    QSvgDeferredPath(QSvgPath *node, const QString &data) : node(node), data(data) {}
+
+    QSvgPath *node;
+    QString data;
+};
+Q_DECLARE_TYPEINFO(QSvgDeferredPath, Q_MOVABLE_TYPE);
+
 class Q_SVG_PRIVATE_EXPORT QSvgHandler
 {
 public:
@@ -136,9 +150,12 @@ public:
     inline QPen defaultPen() const
     { return m_defaultPen; }
 
-    inline QStringList xmlClasses() const 
+    inline const QStringList &xmlClasses() const
     { return m_xmlClasses; }
 
+    QSvgStyleProperty *sharedStyleProperty(QSvgNode *node, QSvgStyleProperty *prop);
+    void deferPathData(QSvgPath *path, const QStringRef &data);
+
 public:
     bool startElement(const QString &localName, const QXmlStreamAttributes &attributes);
     bool endElement(const QStringRef &localName);
@@ -184,9 +201,11 @@ private:
 #endif
     void parse();
     void modifyCss(QString &css);
-    void resolveGradients(QSvgNode *node, int nestedDepth = 0);
+    void resolveReferences();
     void resolveNodes();
-    void setClipStyleNode(QSvgNode *node);
+    void markAnimatedUses(const QVector<QSvgUse *> &uses);
+    void addXmlClass(const QString &xmlClass);
+    void parseDeferredPaths();
 
     QPen m_defaultPen;
     /**
@@ -195,9 +214,18 @@ private:
      */
     const bool m_ownsReader;
 
+    // the distinct classes in document order; the set only answers lookups
     QStringList m_xmlClasses;
+    QSet<QString> m_xmlClassSet;
     typedef QMap<QString, QMap<QString, QVariant>> ClassProperties;
     ClassProperties m_classProperties;
+
+    // fill and stroke properties shared by identically styled nodes
+    QHash<QVector<qreal>, QSvgRefCounter<QSvgStyleProperty> > m_sharedStyles;
+
+    // the path created by the current element, until it is attached
+    QSvgDeferredPath m_pendingPath;
+    QVector<QSvgDeferredPath> m_deferredPaths;
 };
 
 Q_DECLARE_LOGGING_CATEGORY(lcSvgHandler)
@@ -42,9 +42,15 @@
 #ifndef QT_NO_SVG
 #include <QtCore/QXmlStreamWriter>
 #include <QtCore/QBuffer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
 #include "private/qdrawhelper_p.h"
 
 #include "qsvggraphics_p.h"
+#include "qsvgnumberformat_p.h"
 #include "qsvgtinydocument_p.h"
 
 QT_BEGIN_NAMESPACE
@@ -110,31 +116,43 @@ QString translate_dashPattern(const QVector<qreal>& pattern, const qreal& width)
     return patten;
 }
 
-QString translate_matrix(const QMatrix& matrix)
+QString translate_matrix(const QMatrix& matrix, const QSvgNumberFormatter& formatter)
 {
-    return QString::fromLatin1("matrix(%1,%2,%3,%4,%5,%6)")
-        .arg(matrix.m11()).arg(matrix.m12())
-        .arg(matrix.m21()).arg(matrix.m22())
-        .arg(matrix.dx()).arg(matrix.dy());
+    QByteArray str("matrix(");
+    formatter.appendPoint(str, matrix.m11(), matrix.m12());
+    str.append(',');
+    formatter.appendPoint(str, matrix.m21(), matrix.m22());
+    str.append(',');
+    formatter.appendPoint(str, matrix.dx(), matrix.dy());
+    str.append(')');
+    return QString::fromLatin1(str);
 }
 
-QString translate_path(const QPainterPath& path)
+QString translate_path(const QPainterPath& path, const QSvgNumberFormatter& formatter)
 {
-    QString strPath;
+    QByteArray strPath;
     int count = path.elementCount();
+    // each element takes about two numbers of up to a dozen characters
+    strPath.reserve(count * 16);
     for (int i = 0; i < count; i++)
     {
         const QPainterPath::Element& element = path.elementAt(i);
         switch (element.type)
         {
         case QPainterPath::MoveToElement:
-            strPath.append(QString::fromLatin1("M %1 %2 ").arg(element.x).arg(element.y));
+            strPath.append("M ");
+            formatter.appendPoint(strPath, element.x, element.y, ' ');
+            strPath.append(' ');
             break;
         case QPainterPath::LineToElement:
-            strPath.append(QString::fromLatin1("L %1 %2 ").arg(element.x).arg(element.y));
+            strPath.append("L ");
+            formatter.appendPoint(strPath, element.x, element.y, ' ');
+            strPath.append(' ');
             break;
         case QPainterPath::CurveToElement:
-            strPath.append(QString::fromLatin1("C %1 %2 ").arg(element.x).arg(element.y));
+            strPath.append("C ");
+            formatter.appendPoint(strPath, element.x, element.y, ' ');
+            strPath.append(' ');
             ++i;
             while (i < path.elementCount())
             {
@@ -146,7 +164,8 @@ QString translate_path(const QPainterPath& path)
                 }
                 else
                 {
-                    strPath.append(QString::fromLatin1("%1 %2 ").arg(curEle.x).arg(curEle.y));
+                    formatter.appendPoint(strPath, curEle.x, curEle.y, ' ');
+                    strPath.append(' ');
                     ++i;
                 }
             }
@@ -158,10 +177,10 @@ QString translate_path(const QPainterPath& path)
     }
 
     if (count >= 2 && path.elementAt(0).operator QPointF() == path.elementAt(count - 1).operator QPointF())
-        strPath.push_back(QChar::fromLatin1('Z'));
+        strPath.append('Z');
     else
         strPath.chop(1);
-    return strPath;
+    return QString::fromLatin1(strPath);
 }
 
 QString translate_node(QSvgNode::Type type)
@@ -227,13 +246,14 @@ QString translate_length(qreal len, bool bPercent)
 }
 
 
-QString translateCoordList(const QVector<qreal> &list)
+QString translateCoordList(const QVector<qreal> &list, const QSvgNumberFormatter& formatter)
 {
-    QString str;
+    QByteArray str;
     for (const qreal coord : list) {
-        str.append(QString::fromLatin1("%1 ").arg(QString::number(coord)));
+        formatter.appendNumber(str, coord);
+        str.append(' ');
     }
-    return str;
+    return QString::fromLatin1(str);
 }
 
 void writeSolidColor(QXmlStreamWriter* pWriter, const QString& id, const QSvgSolidColorStyle* pStyle)
@@ -251,7 +271,7 @@ void writeSolidColor(QXmlStreamWriter* pWriter, const QString& id, const QSvgSol
     pWriter->writeEndElement();
 }
 
-void writeGradientBase(QXmlStreamWriter* pWriter, const QSvgGradientStyle* pStyle)
+void writeGradientBase(QXmlStreamWriter* pWriter, const QSvgGradientStyle* pStyle, const QSvgNumberFormatter& formatter)
 {
     if (!pStyle->stopLink().isEmpty())
         pWriter->writeAttribute(QLatin1String("xlink:href"), pStyle->stopLink());
@@ -272,7 +292,7 @@ void writeGradientBase(QXmlStreamWriter* pWriter, const QSvgGradientStyle* pStyl
     if (pStyle->matrixSet())
     {
         pWriter->writeAttribute(QLatin1String("gradientTransform"),
-            translate_matrix(pStyle->qmatrix()));
+            translate_matrix(pStyle->qmatrix(), formatter));
     }
 
     if (pStyle->gradientStopsSet())
@@ -325,7 +345,8 @@ void writeGradientBase(QXmlStreamWriter* pWriter, const QSvgGradientStyle* pStyl
     }
 }
 
-void writeGradient(QXmlStreamWriter* pWriter, const QString& id, const QSvgGradientStyle* pStyle)
+void writeGradient(QXmlStreamWriter* pWriter, const QString& id, const QSvgGradientStyle* pStyle,
+                   const QSvgNumberFormatter& formatter)
 {
     if (!pWriter || !pStyle)
         return;
@@ -342,7 +363,7 @@ void writeGradient(QXmlStreamWriter* pWriter, const QString& id, const QSvgGradi
         pWriter->writeAttribute(QLatin1String("x2"), QString::number(lineGra->finalStop().x()));
         pWriter->writeAttribute(QLatin1String("y2"), QString::number(lineGra->finalStop().y()));
 
-        writeGradientBase(pWriter, pStyle);
+        writeGradientBase(pWriter, pStyle, formatter);
         pWriter->writeEndElement();
     }
     else if (gra->type() == QGradient::RadialGradient)
@@ -357,7 +378,7 @@ void writeGradient(QXmlStreamWriter* pWriter, const QString& id, const QSvgGradi
         pWriter->writeAttribute(QLatin1String("fx"), QString::number(radioGra->focalPoint().x()));
         pWriter->writeAttribute(QLatin1String("fy"), QString::number(radioGra->focalPoint().y()));
 
-        writeGradientBase(pWriter, pStyle);
+        writeGradientBase(pWriter, pStyle, formatter);
         pWriter->writeEndElement();
     }
 }
@@ -366,8 +387,8 @@ void writeGradient(QXmlStreamWriter* pWriter, const QString& id, const QSvgGradi
 class QSvgStyleWriter
 {
 public:
-    QSvgStyleWriter(QXmlStreamWriter* writer, const QSvgNode* node)
-        : m_pWriter(writer), m_pNode(node), m_style(node->style())
+    QSvgStyleWriter(QXmlStreamWriter* writer, const QSvgNode* node, const QSvgNumberFormatter& formatter)
+        : m_pWriter(writer), m_pNode(node), m_style(node->style()), m_formatter(formatter)
     {
     }
     void write()
@@ -400,6 +421,7 @@ private:
     QXmlStreamWriter* m_pWriter;
     const QSvgNode*   m_pNode;
     const QSvgStyle&  m_style;
+    const QSvgNumberFormatter& m_formatter;
 };
 
 void QSvgStyleWriter::writeFill()
@@ -602,7 +624,7 @@ void QSvgStyleWriter::writeTransform()
         return;
 
     const QTransform& trans = m_style.transform->qtransform();
-    m_pWriter->writeAttribute(QLatin1String("transform"), translate_matrix(trans.toAffine()));
+    m_pWriter->writeAttribute(QLatin1String("transform"), translate_matrix(trans.toAffine(), m_formatter));
 }
 
 void QSvgStyleWriter::writeVisible()
@@ -718,22 +740,207 @@ void QSvgStyleWriter::writeDisplayMode()
 }
 
 //-----------------------------------------------------------------------------
+// A piece of serialization work that can run on the global thread pool. The
+// thread that needs the result calls wait(), which runs the work itself if
+// no pool thread has picked it up yet, so waiting never starves the pool.
+class QSvgWriterTask : public QRunnable
+{
+public:
+    QSvgWriterTask()
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        work();
+        m_done.release();
+    }
+
+    void wait()
+    {
+        if (QThreadPool::globalInstance()->tryTake(this))
+            run();
+        m_done.acquire();
+        m_done.release(); // allow waiting more than once
+    }
+
+protected:
+    virtual void work() = 0;
+
+private:
+    QSemaphore m_done;
+};
+
+class QSvgImageEncodeTask : public QSvgWriterTask
+{
+public:
+    explicit QSvgImageEncodeTask(const QSvgImage *node) : node(node) {}
+
+    const QSvgImage *node;
+    QString href;
+    bool started = false;
+
+protected:
+    void work() override;
+};
+
+// Encodes the images of a document on the thread pool, a few at a time in
+// document order. Each href is handed out once and then released, so only
+// the encodes in flight are kept in memory.
+class QSvgImageEncodeQueue
+{
+public:
+    explicit QSvgImageEncodeQueue(int maxInFlight) : m_maxInFlight(maxInFlight) {}
+    ~QSvgImageEncodeQueue();
+
+    void add(const QSvgImage *node);
+    void start();
+    bool take(const QSvgNode *node, QString *href);
+
+private:
+    void startPending(); // with m_mutex locked
+
+    QMutex m_mutex;
+    QVector<const QSvgNode *> m_order;
+    QHash<const QSvgNode *, QSvgImageEncodeTask *> m_tasks;
+    int m_next = 0;
+    int m_inFlight = 0;
+    const int m_maxInFlight;
+};
+
+static QString encodedDataHref(const QByteArray &data, const QString &mimeType)
+{
+    return QLatin1String("data:") + mimeType + QLatin1String(";base64,")
+            + QString::fromLatin1(data.toBase64().constData());
+}
+
+static QString encodeImageHref(const QImage &image)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QBuffer::ReadWrite);
+    image.save(&buffer, "PNG");
+    buffer.close();
+
+    return QString::fromLatin1("data:image/png;base64,")
+            .append(QString::fromLatin1(data.toBase64().constData()));
+}
+
+void QSvgImageEncodeTask::work()
+{
+    href = encodeImageHref(node->image());
+}
+
+QSvgImageEncodeQueue::~QSvgImageEncodeQueue()
+{
+    for (QSvgImageEncodeTask *task : qAsConst(m_tasks)) {
+        if (task->started)
+            task->wait();
+    }
+    qDeleteAll(m_tasks);
+}
+
+void QSvgImageEncodeQueue::add(const QSvgImage *node)
+{
+    QSvgImageEncodeTask *task = new QSvgImageEncodeTask(node);
+    m_order.append(node);
+    m_tasks.insert(node, task);
+}
+
+void QSvgImageEncodeQueue::start()
+{
+    QMutexLocker locker(&m_mutex);
+    startPending();
+}
+
+void QSvgImageEncodeQueue::startPending()
+{
+    while (m_inFlight < m_maxInFlight && m_next < m_order.size()) {
+        QSvgImageEncodeTask *task = m_tasks.value(m_order.at(m_next++));
+        if (!task || task->started)
+            continue;
+        task->started = true;
+        ++m_inFlight;
+        QThreadPool::globalInstance()->start(task);
+    }
+}
+
+// Returns the href of \a node's image, encoding it on the calling thread if
+// it wasn't started yet.
+bool QSvgImageEncodeQueue::take(const QSvgNode *node, QString *href)
+{
+    QMutexLocker locker(&m_mutex);
+    QSvgImageEncodeTask *task = m_tasks.take(node);
+    if (!task)
+        return false;
+    const bool queued = task->started;
+    task->started = true;
+    locker.unlock();
+
+    if (queued)
+        task->wait();
+    else
+        task->run();
+    *href = std::move(task->href);
+    delete task;
+
+    locker.relock();
+    if (queued)
+        --m_inFlight;
+    startPending();
+    return true;
+}
+
+// subtrees with fewer nodes than this are not worth a thread pool round trip
+static const int qsvg_minFragmentNodes = 64;
+
+static bool isStructureNode(const QSvgNode *node)
+{
+    switch (node->type()) {
+    case QSvgNode::DOC:
+    case QSvgNode::G:
+    case QSvgNode::DEFS:
+    case QSvgNode::SWITCH:
+    case QSvgNode::MARKER:
+    case QSvgNode::CLIPPATH:
+    case QSvgNode::PATTERN:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Counts the nodes of a subtree, giving up once \a limit is reached.
+static int subtreeSize(const QSvgNode *node, int limit)
+{
+    int count = 1;
+    if (isStructureNode(node)) {
+        for (const QSvgNode *child : static_cast<const QSvgStructureNode *>(node)->renderers()) {
+            count += subtreeSize(child, limit - count);
+            if (count >= limit)
+                break;
+        }
+    }
+    return count;
+}
+
 class QSvgImageWriterPrivate
 {
 public:
     QSvgImageWriterPrivate(const QSvgTinyDocument* doc, QIODevice* device)
-        :doc(doc), xmlWriter(device)
+        :doc(doc), xmlWriter(device), encodedImages(nullptr)
     {
     }
     QSvgImageWriterPrivate(const QSvgTinyDocument* doc, QByteArray* arr)
-        :doc(doc), xmlWriter(arr)
+        :doc(doc), xmlWriter(arr), encodedImages(nullptr)
     {
     }
     bool write();
+    void writeSvgNode(const QSvgNode* node);
 
 protected:
     void writeDoc(const QSvgTinyDocument* doc);
-    void writeSvgNode(const QSvgNode* node);
     void writeStructure(const QSvgStructureNode* structureNode);
     void writeMarker(const QSvgMarker *node);
     void writeClipPath(const QSvgClipPath *node);
@@ -756,11 +963,101 @@ protected:
     void writeDefs(const QSvgTinyDocument* doc);
     void writeSvgFont(const QSvgTinyDocument* doc);
 
+    bool useThreads() const;
+    void collectImages(const QSvgNode *node);
+    void writeChildrenParallel(const QList<QSvgNode *> &children);
+
 public:
     QXmlStreamWriter xmlWriter;
     const QSvgTinyDocument* doc;
+    QSvgNumberFormatter numberFormatter;
+    // images encoded on the thread pool, shared with fragment writers
+    QSvgImageEncodeQueue *encodedImages;
+    QScopedPointer<QSvgImageEncodeQueue> ownedImages;
+    // set when fragment bytes written past the stream writer were lost
+    bool deviceError = false;
+};
+
+// Serializes one top-level subtree into its own buffer; the result is
+// spliced into the output in document order.
+class QSvgFragmentTask : public QSvgWriterTask
+{
+public:
+    QSvgFragmentTask(const QSvgImageWriterPrivate *owner, const QSvgNode *node)
+        : owner(owner), node(node)
+    {
+    }
+
+    QByteArray data;
+    bool failed = false;
+
+protected:
+    void work() override
+    {
+        QSvgImageWriterPrivate writer(owner->doc, &data);
+        writer.xmlWriter.setCodec("UTF-8");
+        writer.numberFormatter = owner->numberFormatter;
+        writer.encodedImages = owner->encodedImages;
+        writer.writeSvgNode(node);
+        failed = writer.xmlWriter.hasError();
+    }
+
+private:
+    const QSvgImageWriterPrivate *owner;
+    const QSvgNode *node;
 };
 
+// Fragments are written with the same codec and without indentation, so
+// their bytes can be copied into the output as they are.
+bool QSvgImageWriterPrivate::useThreads() const
+{
+    return QThreadPool::globalInstance()->maxThreadCount() > 1 && !xmlWriter.autoFormatting();
+}
+
+// Queues every image below \a node that needs encoding, in document order.
+void QSvgImageWriterPrivate::collectImages(const QSvgNode *node)
+{
+    if (node->type() == QSvgNode::IMAGE) {
+        if (static_cast<const QSvgImage *>(node)->encodedData().isEmpty())
+            ownedImages->add(static_cast<const QSvgImage *>(node));
+    } else if (isStructureNode(node)) {
+        for (const QSvgNode *child : static_cast<const QSvgStructureNode *>(node)->renderers())
+            collectImages(child);
+    }
+}
+
+void QSvgImageWriterPrivate::writeChildrenParallel(const QList<QSvgNode *> &children)
+{
+    QVector<QSvgFragmentTask *> fragments(children.size(), nullptr);
+    for (int i = 0; i < children.size(); ++i) {
+        const QSvgNode *child = children.at(i);
+        if (!isStructureNode(child))
+            continue;
+        if (subtreeSize(child, qsvg_minFragmentNodes) < qsvg_minFragmentNodes)
+            continue;
+        fragments[i] = new QSvgFragmentTask(this, child);
+        QThreadPool::globalInstance()->start(fragments[i]);
+    }
+
+    for (int i = 0; i < children.size(); ++i) {
+        QSvgFragmentTask *fragment = fragments.at(i);
+        if (!fragment) {
+            writeSvgNode(children.at(i));
+            continue;
+        }
+        fragment->wait();
+        if (fragment->failed) {
+            qWarning("QSvgImageWriterPrivate::write(), could not write a subtree in parallel");
+            writeSvgNode(children.at(i));
+        } else {
+            xmlWriter.writeCharacters(QString()); // finish a pending start tag
+            if (xmlWriter.device()->write(fragment->data) != fragment->data.size())
+                deviceError = true;
+        }
+        delete fragment;
+    }
+}
+
 bool QSvgImageWriterPrivate::write()
 {
     if (!xmlWriter.device()) 
@@ -785,9 +1082,25 @@ bool QSvgImageWriterPrivate::write()
     }
 
     xmlWriter.setCodec("UTF-8");
+
+    if (useThreads()) {
+        ownedImages.reset(new QSvgImageEncodeQueue(QThreadPool::globalInstance()->maxThreadCount()));
+        collectImages(doc);
+        ownedImages->start();
+        encodedImages = ownedImages.data();
+    }
+
     xmlWriter.writeStartDocument(QLatin1String("1.0"), true);
     writeSvgNode(doc);
     xmlWriter.writeEndDocument();
+
+    encodedImages = nullptr;
+    ownedImages.reset();
+
+    if (xmlWriter.hasError() || deviceError) {
+        qWarning("QSvgImageWriterPrivate::write(), could not write to the output device");
+        return false;
+    }
     return true;
 }
 
@@ -874,6 +1187,11 @@ void QSvgImageWriterPrivate::writeSvgNode(const QSvgNode* node)
 
 void QSvgImageWriterPrivate::writeStructure(const QSvgStructureNode* structureNode)
 {
+    if (structureNode == doc && ownedImages) {
+        writeChildrenParallel(structureNode->renderers());
+        return;
+    }
+
     for (QSvgNode* node : structureNode->renderers())
         writeSvgNode(node);
 }
@@ -951,17 +1269,15 @@ void QSvgImageWriterPrivate::writeImage(const QSvgImage* node)
     xmlWriter.writeAttribute(QLatin1String("width"), QString::number(rect.width()));
     xmlWriter.writeAttribute(QLatin1String("height"), QString::number(rect.height()));
 
-    {
-        const QImage& image = node->image();
-        QByteArray data;
-        QBuffer buffer(&data);
-        buffer.open(QBuffer::ReadWrite);
-        image.save(&buffer, "PNG");
-        buffer.close();
-
-        QString imgBase64 = QString::fromLatin1("data:image/png;base64,")
-                                    .append(QString::fromLatin1(data.toBase64().constData()));
-        xmlWriter.writeAttribute(QLatin1String("xlink:href"), imgBase64);
+    QString href;
+    if (!node->encodedData().isEmpty()) {
+        // the parsed payload is written back untouched instead of re-encoding the pixels
+        xmlWriter.writeAttribute(QLatin1String("xlink:href"),
+                                 encodedDataHref(node->encodedData(), node->mimeType()));
+    } else if (encodedImages && encodedImages->take(node, &href)) {
+        xmlWriter.writeAttribute(QLatin1String("xlink:href"), href);
+    } else {
+        xmlWriter.writeAttribute(QLatin1String("xlink:href"), encodeImageHref(node->image()));
     }
 }
 
@@ -978,7 +1294,7 @@ void QSvgImageWriterPrivate::writeLine(const QSvgLine* node)
 
 void QSvgImageWriterPrivate::writePath(const QSvgPath* node)
 {
-    xmlWriter.writeAttribute(QLatin1String("d"), translate_path(node->path()));
+    xmlWriter.writeAttribute(QLatin1String("d"), translate_path(node->path(), numberFormatter));
     writeMarkerLink(xmlWriter, node->Marker());
 }
 
@@ -1011,7 +1327,7 @@ void QSvgImageWriterPrivate::writePattern(const QSvgPattern *node)
 
     if (node->style().transform) {
         const QTransform& trans = node->style().transform->qtransform();
-        xmlWriter.writeAttribute(QLatin1String("patternTransform"), translate_matrix(trans.toAffine()));
+        xmlWriter.writeAttribute(QLatin1String("patternTransform"), translate_matrix(trans.toAffine(), numberFormatter));
     }
 }
 
@@ -1036,12 +1352,14 @@ void QSvgImageWriterPrivate::writePoly(const QSvgNode* node)
 void QSvgImageWriterPrivate::writePolyInner(const QPolygonF & poly)
 {
     Q_ASSERT(poly.size() > 0);
-    QString strPoints = QString::fromLatin1("%1,%2").arg(poly[0].x()).arg(poly[0].y());
+    QByteArray strPoints;
+    numberFormatter.appendPoint(strPoints, poly[0].x(), poly[0].y());
     for (int i = 1; i < poly.size(); ++i)
     {
-        strPoints.append(QString::fromLatin1(" %1,%2").arg(poly[i].x()).arg(poly[i].y()));
+        strPoints.append(' ');
+        numberFormatter.appendPoint(strPoints, poly[i].x(), poly[i].y());
     }
-    xmlWriter.writeAttribute(QLatin1String("points"), strPoints);
+    xmlWriter.writeAttribute(QLatin1String("points"), QString::fromLatin1(strPoints));
 }
 
 void QSvgImageWriterPrivate::writeRect(const QSvgRect* node)
@@ -1079,16 +1397,16 @@ void QSvgImageWriterPrivate::writeTspan(const QSvgTspan* node)
         xmlWriter.writeAttribute(QLatin1String("xml:space"), QLatin1String("preserve"));
 
     if (!node->coordX().empty()) {
-        xmlWriter.writeAttribute(QLatin1String("x"), translateCoordList(node->coordX()));
+        xmlWriter.writeAttribute(QLatin1String("x"), translateCoordList(node->coordX(), numberFormatter));
     }
     if (!node->coordY().empty()) {
-        xmlWriter.writeAttribute(QLatin1String("y"), translateCoordList(node->coordY()));
+        xmlWriter.writeAttribute(QLatin1String("y"), translateCoordList(node->coordY(), numberFormatter));
     }
     if (!node->offsetX().empty()) {
-        xmlWriter.writeAttribute(QLatin1String("dx"), translateCoordList(node->offsetX()));
+        xmlWriter.writeAttribute(QLatin1String("dx"), translateCoordList(node->offsetX(), numberFormatter));
     }
     if (!node->offsetY().empty()) {
-        xmlWriter.writeAttribute(QLatin1String("dy"), translateCoordList(node->offsetY()));
+        xmlWriter.writeAttribute(QLatin1String("dy"), translateCoordList(node->offsetY(), numberFormatter));
     }
 
     for (const QSvgTspan *child : node->renderers()) {
@@ -1145,7 +1463,7 @@ void QSvgImageWriterPrivate::writeNodeCore(const QSvgNode* node)
 
 void QSvgImageWriterPrivate::writeNodeStyle(const QSvgNode* node)
 {
-    QSvgStyleWriter styleWriter(&xmlWriter, node);
+    QSvgStyleWriter styleWriter(&xmlWriter, node, numberFormatter);
     styleWriter.write();
 }
 
@@ -1163,7 +1481,7 @@ void QSvgImageWriterPrivate::writeDefs(const QSvgTinyDocument* doc)
         if (prop->type() == QSvgStyleProperty::SOLID_COLOR)
             writeSolidColor(&xmlWriter, iter.key(), static_cast<const QSvgSolidColorStyle*>(prop));
         else if (prop->type() == QSvgStyleProperty::GRADIENT)
-            writeGradient(&xmlWriter, iter.key(), static_cast<const QSvgGradientStyle*>(prop));
+            writeGradient(&xmlWriter, iter.key(), static_cast<const QSvgGradientStyle*>(prop), numberFormatter);
     }
 
     xmlWriter.writeEndElement();
@@ -1199,7 +1517,7 @@ void QSvgImageWriterPrivate::writeSvgFont(const QSvgTinyDocument* doc)
                 {
                     xmlWriter.writeStartElement(QLatin1String("missing-glyph"));
                     xmlWriter.writeAttribute(QLatin1String("horiz-adv-x"), QString::number(glyph.m_horizAdvX));
-                    xmlWriter.writeAttribute(QLatin1String("d"), translate_path(glyph.m_path));
+                    xmlWriter.writeAttribute(QLatin1String("d"), translate_path(glyph.m_path, numberFormatter));
                     xmlWriter.writeEndElement();
                 }
                 else
@@ -1207,7 +1525,7 @@ void QSvgImageWriterPrivate::writeSvgFont(const QSvgTinyDocument* doc)
                     xmlWriter.writeStartElement(QLatin1String("glyph"));
                     xmlWriter.writeAttribute(QLatin1String("unicode"), QString(glyph.m_unicode));
                     xmlWriter.writeAttribute(QLatin1String("horiz-adv-x"), QString::number(glyph.m_horizAdvX));
-                    xmlWriter.writeAttribute(QLatin1String("d"), translate_path(glyph.m_path));
+                    xmlWriter.writeAttribute(QLatin1String("d"), translate_path(glyph.m_path, numberFormatter));
                     xmlWriter.writeEndElement();
                 }
             }
@@ -1248,9 +1566,19 @@ QIODevice* QSvgImageWriter::device() const
     return d->xmlWriter.device();
 }
 
-void QSvgImageWriter::write()
+bool QSvgImageWriter::write()
+{
+    return d->write();
+}
+
+int QSvgImageWriter::coordinatePrecision() const
+{
+    return d->numberFormatter.precision();
+}
+
+void QSvgImageWriter::setCoordinatePrecision(int precision)
 {
-    d->write();
+    d->numberFormatter.setPrecision(precision);
 }
 
 QT_END_NAMESPACE
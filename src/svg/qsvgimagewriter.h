@@ -59,9 +59,14 @@ public:
     QSvgImageWriter(const QSvgTinyDocument* doc, QByteArray* arr);
     virtual ~QSvgImageWriter();
 
-    void write();
+    bool write();
     QIODevice *device() const;
 
+    // significant digits of path data, transforms and coordinate lists;
+    // QLocale::FloatingPointShortest writes exact round-trip values
+    int coordinatePrecision() const;
+    void setCoordinatePrecision(int precision);
+
 private:
     QScopedPointer<QSvgImageWriterPrivate> d;
 };
@@ -41,15 +41,20 @@
 #include "qsvgtinydocument_p.h"
 
 #include "qdebug.h"
+#include "qmath.h"
 #include "qstack.h"
 
 QT_BEGIN_NAMESPACE
 
 QSvgNode::QSvgNode(QSvgNode *parent)
     : m_parent(parent),
+      m_document(parent ? parent->document() : nullptr),
+      m_computedStyle(-1),
+      m_idHandle(-1),
       m_visible(true),
       m_displayMode(BlockMode), 
       m_bClipRuleSet(false),
+      m_subtreeAnimated(false),
       m_clipRule(Qt::WindingFill),
       m_targetBounds(QRectF())
 {
@@ -80,6 +85,10 @@ void QSvgNode::appendStyleProperty(QSvgStyleProperty *prop, const QString &id)
 {
     //qDebug()<<"appending "<<prop->type()<< " ("<< id <<") "<<"to "<<this<<this->type();
     QSvgTinyDocument *doc;
+    // the descendants may inherit the new property as well
+    if (m_computedStyle >= 0 && m_document)
+        m_document->clearComputedStyles();
+
     switch (prop->type()) {
     case QSvgStyleProperty::QUALITY:
         m_style.quality = static_cast<QSvgQualityStyle*>(prop);
@@ -145,6 +154,25 @@ void QSvgNode::revertStyle(QPainter *p, QSvgExtraStates &states) const
 
 QSvgStyleProperty * QSvgNode::styleProperty(QSvgStyleProperty::Type type) const
 {
+    if (const QSvgComputedStyle *computed = m_document ? m_document->computedStyle(m_computedStyle) : nullptr) {
+        switch (type) {
+        case QSvgStyleProperty::FILL:
+            return computed->fill;
+        case QSvgStyleProperty::STROKE:
+            return computed->stroke;
+        case QSvgStyleProperty::FONT:
+            return computed->font;
+        case QSvgStyleProperty::TRANSFORM:
+            return computed->transform;
+        case QSvgStyleProperty::OPACITY:
+            return computed->opacity;
+        case QSvgStyleProperty::CLIPPATH:
+            return computed->clipPath;
+        default:
+            break;
+        }
+    }
+
     if (QSvgStyleProperty::CLIPPATH == type && this->m_style.clipPath)
         return this->m_style.clipPath;
 
@@ -218,7 +246,7 @@ QSvgFillStyleProperty * QSvgNode::styleProperty(const QString &id) const
     return doc ? doc->namedStyle(id) : 0;
 }
 
-QRectF QSvgNode::bounds(QPainter *, QSvgExtraStates &, bool) const
+QRectF QSvgNode::bounds(const QSvgBoundsState &, bool) const
 {
     return QRectF(0, 0, 0, 0);
 }
@@ -228,15 +256,9 @@ QRectF QSvgNode::transformedBounds() const
     if (!m_cachedBounds.isEmpty())
         return m_cachedBounds;
 
-    QImage dummy(1, 1, QImage::Format_RGB32);
-    QPainter p(&dummy);
-    QSvgExtraStates states;
-
-    QPen pen(Qt::NoBrush, 1, Qt::SolidLine, Qt::FlatCap, Qt::SvgMiterJoin);
-    pen.setMiterLimit(4);
-    pen.setSupportComoplex(false);
-    p.setPen(pen);
-
+    // Only the inherited stroke matters here, the result is in the
+    // coordinate system of the parent.
+    QSvgBoundsState state;
     QStack<QSvgNode*> parentApplyStack;
     QSvgNode *parent = m_parent;
     while (parent) {
@@ -245,24 +267,31 @@ QRectF QSvgNode::transformedBounds() const
     }
 
     for (int i = parentApplyStack.size() - 1; i >= 0; --i)
-        parentApplyStack[i]->applyStyle(&p, states);
-    
-    p.setWorldTransform(QTransform());
+        parentApplyStack[i]->m_style.applyBounds(parentApplyStack[i], state);
+
+    state.transform = QTransform();
 
-    m_cachedBounds = transformedBounds(&p, states, true);
+    m_cachedBounds = transformedBounds(state, true);
     return m_cachedBounds;
 }
 
-QSvgTinyDocument * QSvgNode::document() const
+void QSvgNode::setParent(QSvgNode *parent)
 {
-    QSvgTinyDocument *doc = 0;
-    QSvgNode *node = const_cast<QSvgNode*>(this);
-    while (node && node->type() != QSvgNode::DOC) {
-        node = node->parent();
-    }
-    doc = static_cast<QSvgTinyDocument*>(node);
+    m_parent = parent;
+    // clones are reparented bottom up, so only the topmost call of a
+    // clone() actually has to update its subtree
+    QSvgTinyDocument *doc = parent ? parent->document() : nullptr;
+    if (doc != m_document)
+        setDocument(doc);
+}
 
-    return doc;
+void QSvgNode::setDocument(QSvgTinyDocument *doc)
+{
+    m_document = doc;
+    m_computedStyle = -1;
+    // a cloned document takes over the id handles of its cloned nodes
+    if (m_idHandle >= 0 && doc)
+        doc->adoptNamedNode(this);
 }
 
 void QSvgNode::setRequiredFeatures(const QStringList &lst)
@@ -324,18 +353,27 @@ void QSvgNode::setVisible(bool visible)
     if (m_parent && visible && !m_parent->isVisible())
         m_parent->setVisible(true);
 
+    if (m_visible != visible && m_document)
+        m_document->releaseStaticLayers();
     m_visible = visible;
 }
 
-QRectF QSvgNode::transformedBounds(QPainter *p, QSvgExtraStates &states,
+// Marks this node and its ancestors as containing animations, so that static
+// subtrees can be told apart when rendering.
+void QSvgNode::markSubtreeAnimated()
+{
+    for (QSvgNode *node = this; node && !node->m_subtreeAnimated; node = node->m_parent)
+        node->m_subtreeAnimated = true;
+}
+
+QRectF QSvgNode::transformedBounds(QSvgBoundsState state,
                                    bool defaultViewCoord /*= false*/) const
 {
     if (defaultViewCoord && m_cachedBounds.isValid())
         return m_cachedBounds;
 
-    applyStyle(p, states);
-    QRectF rect = bounds(p, states, defaultViewCoord);
-    revertStyle(p, states);
+    m_style.applyBounds(this, state);
+    QRectF rect = bounds(state, defaultViewCoord);
 
     if (defaultViewCoord && m_cachedBounds.isEmpty() && rect.isValid())
         m_cachedBounds = rect;
@@ -363,6 +401,8 @@ void QSvgNode::setXmlClass(const QString &str)
 
 void QSvgNode::setDisplayMode(DisplayMode mode)
 {
+    if (m_displayMode != mode && m_document)
+        m_document->releaseStaticLayers();
     m_displayMode = mode;
 }
 
@@ -387,12 +427,22 @@ Qt::FillRule QSvgNode::clipRule() const
     return m_clipRule;
 }
 
-qreal QSvgNode::strokeWidth(QPainter *p)
+// Grows the device space bounds of a shape by its stroke without building the
+// stroke outline: half the pen width (times sqrt(2) for square caps at open
+// ends), mapped through the linear part of the transform.
+QRectF QSvgNode::strokedBounds(const QRectF &mappedBounds, const QSvgBoundsState &state,
+                               bool openEnds)
 {
-    QPen pen = p->pen();
-    if (pen.style() == Qt::NoPen || pen.brush().style() == Qt::NoBrush || pen.isCosmetic())
-        return 0;
-    return pen.widthF();
+    qreal radius = state.strokeWidth() / 2;
+    if (qFuzzyIsNull(radius))
+        return mappedBounds;
+    if (openEnds)
+        radius *= M_SQRT2;
+
+    const QTransform &t = state.transform;
+    const qreal dx = radius * qSqrt(t.m11() * t.m11() + t.m21() * t.m21());
+    const qreal dy = radius * qSqrt(t.m12() * t.m12() + t.m22() * t.m22());
+    return mappedBounds.adjusted(-dx, -dy, dx, dy);
 }
 
 QT_END_NAMESPACE
@@ -129,11 +129,11 @@ public:
     QSvgFillStyleProperty *styleProperty(const QString &id) const;
 
     QSvgTinyDocument *document() const;
+    virtual void setDocument(QSvgTinyDocument *doc);
 
     virtual Type type() const =0;
-    virtual QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const;
-    virtual QRectF transformedBounds(QPainter *p, QSvgExtraStates &states,
-                                     bool defaultViewCoord = false) const;
+    virtual QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const;
+    virtual QRectF transformedBounds(QSvgBoundsState state, bool defaultViewCoord = false) const;
     virtual QSvgNode *getFillPattern();
     virtual void updateFillPattern(QSvgNode*);
     QRectF transformedBounds() const;
@@ -158,6 +158,9 @@ public:
     void setVisible(bool visible);
     bool isVisible() const;
 
+    void markSubtreeAnimated();
+    bool isSubtreeAnimated() const;
+
     void setDisplayMode(DisplayMode display);
     DisplayMode displayMode() const;
 
@@ -178,9 +181,13 @@ protected:
     mutable QSvgStyle m_style;
     QRectF m_targetBounds;
 
-    static qreal strokeWidth(QPainter *p);
+    static QRectF strokedBounds(const QRectF &mappedBounds, const QSvgBoundsState &state,
+                                bool openEnds);
 private:
     QSvgNode   *m_parent;
+    QSvgTinyDocument *m_document;
+    int m_computedStyle;
+    int m_idHandle;
 
     QStringList m_requiredFeatures;
     QStringList m_requiredExtensions;
@@ -190,6 +197,7 @@ private:
 
     bool        m_visible;
     bool        m_bClipRuleSet;
+    bool        m_subtreeAnimated;
 
     QString m_id;
     QString m_class;
@@ -206,9 +214,9 @@ inline QSvgNode *QSvgNode::parent() const
     return m_parent;
 }
 
-inline void QSvgNode::setParent(QSvgNode *parent)
+inline QSvgTinyDocument *QSvgNode::document() const
 {
-    m_parent = parent;
+    return m_document;
 }
 
 inline bool QSvgNode::isVisible() const
@@ -216,6 +224,11 @@ inline bool QSvgNode::isVisible() const
     return m_visible;
 }
 
+inline bool QSvgNode::isSubtreeAnimated() const
+{
+    return m_subtreeAnimated;
+}
+
 inline QString QSvgNode::nodeId() const
 {
     return m_id;
@@ -0,0 +1,211 @@
+/****************************************************************************
+**
+** Copyright (C) 2016 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt SVG module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include "qsvgnumberformat_p.h"
+
+#include "qlocale.h"
+#include "qnumeric.h"
+
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+static const double qsvg_powersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Largest precision for which the mantissa and the rounding midpoint stay
+// exactly representable as doubles.
+static const int qsvg_maxFastDigits = 15;
+
+// Rounds the positive, finite \a value to \a digits significant digits, half
+// away from zero like Qt's own conversion. On success *mantissa holds exactly
+// \a digits digits and *exponent the decimal exponent of the first one. The
+// powers of ten involved are exact, so fma() yields the exact sign of
+// value * 10^s - candidate and no double rounding can creep in.
+static bool qsvg_roundSignificant(double value, int digits, quint64 *mantissa, int *exponent)
+{
+    int e = int(std::floor(std::log10(value)));
+    const double lower = qsvg_powersOf10[digits - 1];
+    const double upper = qsvg_powersOf10[digits];
+
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        const int s = digits - 1 - e;
+        if (s > 22 || s < -22)
+            return false;
+
+        double m;
+        if (s >= 0) {
+            const double p = qsvg_powersOf10[s];
+            m = std::floor(value * p);
+            if (std::fma(value, p, -m) < 0)
+                m -= 1;
+            else if (std::fma(value, p, -(m + 1)) >= 0)
+                m += 1;
+            if (std::fma(value, p, -(m + 0.5)) >= 0)
+                m += 1;
+        } else {
+            const double p = qsvg_powersOf10[-s];
+            m = std::floor(value / p);
+            if (std::fma(m, p, -value) > 0)
+                m -= 1;
+            else if (std::fma(m + 1, p, -value) <= 0)
+                m += 1;
+            if (std::fma(m + 0.5, p, -value) <= 0)
+                m += 1;
+        }
+
+        if (m == upper) { // rounded up to the next power of ten
+            m = lower;
+            ++e;
+        } else if (m > upper) {
+            ++e;
+            continue;
+        } else if (m < lower) {
+            --e;
+            continue;
+        }
+
+        *mantissa = quint64(m);
+        *exponent = e;
+        return true;
+    }
+    return false;
+}
+
+static bool qsvg_roundTrips(double value, quint64 mantissa, int digits, int exponent)
+{
+    const int s = digits - 1 - exponent;
+    if (s >= 0)
+        return s <= 22 && double(mantissa) / qsvg_powersOf10[s] == value;
+    return -s <= 22 && double(mantissa) * qsvg_powersOf10[-s] == value;
+}
+
+QSvgNumberFormatter::QSvgNumberFormatter(int precision)
+    : m_precision(DefaultPrecision)
+{
+    setPrecision(precision);
+}
+
+void QSvgNumberFormatter::setPrecision(int precision)
+{
+    if (precision == QLocale::FloatingPointShortest)
+        m_precision = precision;
+    else
+        m_precision = qBound(1, precision, 17);
+}
+
+void QSvgNumberFormatter::appendNumber(QByteArray &out, double value) const
+{
+    if (value == 0) {
+        if (std::signbit(value))
+            out.append('-');
+        out.append('0');
+        return;
+    }
+
+    const bool shortest = m_precision == QLocale::FloatingPointShortest;
+    const int digits = shortest ? qsvg_maxFastDigits : m_precision;
+    const double magnitude = std::fabs(value);
+    quint64 mantissa;
+    int exponent;
+    if (!qIsFinite(value) || digits > qsvg_maxFastDigits
+            || !qsvg_roundSignificant(magnitude, digits, &mantissa, &exponent)
+            || (shortest && !qsvg_roundTrips(magnitude, mantissa, digits, exponent))) {
+        out.append(QByteArray::number(value, 'g', m_precision));
+        return;
+    }
+
+    char buf[24];
+    int length = digits;
+    for (int i = digits - 1; i >= 0; --i) {
+        buf[i] = char('0' + mantissa % 10);
+        mantissa /= 10;
+    }
+    while (length > 1 && buf[length - 1] == '0')
+        --length;
+
+    // Like 'g': plain decimals unless the exponent falls outside the
+    // precision. The shortest form uses QLocale's cutoff, which allows as
+    // many trailing zeros as the exponent notation would take characters.
+    const int absExponent = exponent < 0 ? -exponent : exponent;
+    const int decimalPoint = exponent + 1;
+    int cutoff = shortest ? DefaultPrecision : digits;
+    if (shortest && decimalPoint > 0) {
+        cutoff = length + 4 + (decimalPoint > 100 ? 2 : 1);
+        if (length > decimalPoint)
+            ++cutoff;
+    }
+    const bool scientific = decimalPoint != length
+            && (decimalPoint <= -4 || decimalPoint > cutoff);
+
+    if (value < 0)
+        out.append('-');
+
+    if (scientific) {
+        out.append(buf[0]);
+        if (length > 1) {
+            out.append('.');
+            out.append(buf + 1, length - 1);
+        }
+        out.append('e');
+        out.append(exponent < 0 ? '-' : '+');
+        if (absExponent >= 100)
+            out.append(char('0' + absExponent / 100));
+        out.append(char('0' + absExponent / 10 % 10));
+        out.append(char('0' + absExponent % 10));
+    } else if (exponent < 0) {
+        out.append("0.", 2);
+        for (int i = exponent + 1; i < 0; ++i)
+            out.append('0');
+        out.append(buf, length);
+    } else if (exponent + 1 >= length) {
+        out.append(buf, length);
+        for (int i = length; i <= exponent; ++i)
+            out.append('0');
+    } else {
+        out.append(buf, exponent + 1);
+        out.append('.');
+        out.append(buf + exponent + 1, length - exponent - 1);
+    }
+}
+
+QT_END_NAMESPACE
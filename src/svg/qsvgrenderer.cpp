@@ -44,10 +44,18 @@
 #include "qsvgtinydocument_p.h"
 
 #include "qbytearray.h"
-#include "qtimer.h"
+#include "qbasictimer.h"
+#include "qcoreevent.h"
+#include "qelapsedtimer.h"
+#include "qpointer.h"
+#include "qthread.h"
+#include "qthreadstorage.h"
+#include "qvector.h"
 #include "qdebug.h"
 #include "private/qobject_p.h"
 
+#include <limits>
+
 
 QT_BEGIN_NAMESPACE
 
@@ -100,14 +108,42 @@ QT_BEGIN_NAMESPACE
     \sa QSvgWidget, {Qt SVG C++ Classes}, {SVG Viewer Example}, QPicture
 */
 
+// Emits repaintNeeded() for all animated renderers of a thread from one
+// timer, so that renderers running at the same frame rate share a wakeup.
+class QSvgAnimationTicker : public QObject
+{
+public:
+    static QSvgAnimationTicker *instance();
+
+    void subscribe(QSvgRenderer *renderer, int interval);
+    void unsubscribe(QSvgRenderer *renderer);
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void updateTimer();
+
+    struct Subscriber {
+        QSvgRenderer *renderer;
+        int interval;
+        qint64 due;
+    };
+    QVector<Subscriber> m_subscribers;
+    QBasicTimer m_timer;
+    QElapsedTimer m_clock;
+    int m_interval = 0;
+};
+
 class QSvgRendererPrivate : public QObjectPrivate
 {
     Q_DECLARE_PUBLIC(QSvgRenderer)
 public:
     explicit QSvgRendererPrivate()
         : QObjectPrivate(),
-          render(0), timer(0),
-          fps(30)
+          render(0),
+          fps(30),
+          animationActive(true)
     {}
     ~QSvgRendererPrivate()
     {
@@ -115,12 +151,122 @@ public:
     }
 
     static void callRepaintNeeded(QSvgRenderer *const q);
+    void updateAnimationTicker();
 
     QSvgTinyDocument *render;
-    QTimer *timer;
+    QPointer<QSvgAnimationTicker> ticker;
     int fps;
+    bool animationActive;
 };
 
+Q_GLOBAL_STATIC(QThreadStorage<QSvgAnimationTicker *>, animationTickers)
+
+QSvgAnimationTicker *QSvgAnimationTicker::instance()
+{
+    QThreadStorage<QSvgAnimationTicker *> *tickers = animationTickers();
+    if (!tickers->hasLocalData())
+        tickers->setLocalData(new QSvgAnimationTicker);
+    return tickers->localData();
+}
+
+void QSvgAnimationTicker::subscribe(QSvgRenderer *renderer, int interval)
+{
+    if (!m_clock.isValid())
+        m_clock.start();
+
+    interval = qMax(interval, 1);
+    const qint64 due = m_clock.elapsed() + interval;
+    for (Subscriber &subscriber : m_subscribers) {
+        if (subscriber.renderer == renderer) {
+            subscriber.interval = interval;
+            subscriber.due = due;
+            updateTimer();
+            return;
+        }
+    }
+    m_subscribers.append({renderer, interval, due});
+    updateTimer();
+}
+
+void QSvgAnimationTicker::unsubscribe(QSvgRenderer *renderer)
+{
+    for (int i = 0; i < m_subscribers.size(); ++i) {
+        if (m_subscribers.at(i).renderer == renderer) {
+            m_subscribers.remove(i);
+            updateTimer();
+            return;
+        }
+    }
+}
+
+void QSvgAnimationTicker::updateTimer()
+{
+    int interval = 0;
+    for (const Subscriber &subscriber : qAsConst(m_subscribers))
+        interval = interval ? qMin(interval, subscriber.interval) : subscriber.interval;
+
+    if (interval == m_interval)
+        return;
+    m_interval = interval;
+    if (interval)
+        m_timer.start(interval, Qt::PreciseTimer, this);
+    else
+        m_timer.stop();
+}
+
+void QSvgAnimationTicker::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_timer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    // Half a tick of slack, so renderers whose interval is a multiple of the
+    // timer interval are not pushed to the following tick by timer jitter.
+    const qint64 now = m_clock.elapsed();
+    const qint64 slack = m_interval / 2;
+    QVector<QPointer<QSvgRenderer>> dueRenderers;
+    for (Subscriber &subscriber : m_subscribers) {
+        if (subscriber.due - slack > now)
+            continue;
+        subscriber.due += subscriber.interval;
+        if (subscriber.due <= now)
+            subscriber.due = now + subscriber.interval;
+        dueRenderers.append(subscriber.renderer);
+    }
+
+    // Slots may load documents, deactivate or delete renderers.
+    for (const QPointer<QSvgRenderer> &renderer : qAsConst(dueRenderers)) {
+        if (renderer)
+            QSvgRendererPrivate::callRepaintNeeded(renderer);
+    }
+}
+
+// The ticker belongs to the thread of the renderer, and is only used from
+// that thread.
+void QSvgRendererPrivate::updateAnimationTicker()
+{
+    Q_Q(QSvgRenderer);
+    if (QThread::currentThread() != q->thread()) {
+        QMetaObject::invokeMethod(q, [this] { updateAnimationTicker(); }, Qt::QueuedConnection);
+        return;
+    }
+
+    if (render && render->animated() && fps > 0 && animationActive) {
+        if (!ticker)
+            ticker = QSvgAnimationTicker::instance();
+        ticker->subscribe(q, 1000 / fps);
+    } else {
+        if (ticker) {
+            ticker->unsubscribe(q);
+            ticker = nullptr;
+        }
+        // nothing redraws the animation until it is resumed
+        if (render)
+            render->releaseStaticLayers();
+    }
+}
+
 /*!
     Constructs a new renderer with the given \a parent.
 */
@@ -166,7 +312,24 @@ QSvgRenderer::QSvgRenderer(QXmlStreamReader *contents, QObject *parent)
 */
 QSvgRenderer::~QSvgRenderer()
 {
+    Q_D(QSvgRenderer);
+    if (d->ticker)
+        d->ticker->unsubscribe(this);
+}
 
+/*!
+    \reimp
+*/
+bool QSvgRenderer::event(QEvent *event)
+{
+    Q_D(QSvgRenderer);
+    if (event->type() == QEvent::ThreadChange && d->ticker) {
+        // Sent in the old thread; subscribe again once in the new one.
+        d->ticker->unsubscribe(this);
+        d->ticker = nullptr;
+        QMetaObject::invokeMethod(this, [d] { d->updateAnimationTicker(); }, Qt::QueuedConnection);
+    }
+    return QObject::event(event);
 }
 
 /*!
@@ -253,6 +416,37 @@ void QSvgRenderer::setFramesPerSecond(int num)
         return;
     }
     d->fps = num;
+    d->updateAnimationTicker();
+}
+
+/*!
+    \property QSvgRenderer::animationActive
+    \brief whether the renderer emits repaintNeeded() for animation frames
+
+    Animated documents are driven by a timer shared by all renderers of a
+    thread, which emits repaintNeeded() at the rate given by
+    framesPerSecond. Setting this property to false takes the renderer off
+    that timer, for example while whatever displays it is hidden, and
+    setting it back to true resumes the ticks. The animation clock itself
+    keeps running, so the document continues at the current time on resume.
+
+    The default is true.
+
+    \sa animated(), framesPerSecond, repaintNeeded()
+*/
+bool QSvgRenderer::isAnimationActive() const
+{
+    Q_D(const QSvgRenderer);
+    return d->animationActive;
+}
+
+void QSvgRenderer::setAnimationActive(bool active)
+{
+    Q_D(QSvgRenderer);
+    if (d->animationActive == active)
+        return;
+    d->animationActive = active;
+    d->updateAnimationTicker();
 }
 
 /*!
@@ -318,17 +512,7 @@ static bool loadDocument(QSvgRenderer *const q,
         delete d->render;
         d->render = nullptr;
     }
-    if (d->render && d->render->animated() && d->fps > 0) {
-        if (!d->timer)
-            d->timer = new QTimer(q);
-        else
-            d->timer->stop();
-        q->connect(d->timer, SIGNAL(timeout()),
-                   q, SIGNAL(repaintNeeded()));
-        d->timer->start(1000/d->fps);
-    } else if (d->timer) {
-        d->timer->stop();
-    }
+    d->updateAnimationTicker();
 
     //force first update
     QSvgRendererPrivate::callRepaintNeeded(q);
@@ -346,16 +530,7 @@ static bool loadDocument(QSvgRenderer *const q, QSvgRendererPrivate *const d, co
         delete d->render;
         d->render = nullptr;
     }
-    if (d->render && d->render->animated() && d->fps > 0) {
-        if (!d->timer)
-            d->timer = new QTimer(q);
-        else
-            d->timer->stop();
-        q->connect(d->timer, SIGNAL(timeout()), q, SIGNAL(repaintNeeded()));
-        d->timer->start(1000 / d->fps);
-    } else if (d->timer) {
-        d->timer->stop();
-    }
+    d->updateAnimationTicker();
 
     // force first update
     QSvgRendererPrivate::callRepaintNeeded(q);
@@ -452,6 +627,27 @@ void QSvgRenderer::render(QPainter *painter, const QRectF &bounds)
     }
 }
 
+/*!
+    Renders the document using the given \a painter on the specified
+    \a bounds, with its animations evaluated \a timeMs milliseconds after
+    their start.
+
+    Unlike render(), this does not depend on or advance the animation
+    clock, so any frame of an animated document can be rendered
+    deterministically and in any order. For a document without animations
+    this is the same as render().
+
+    \sa render(), currentFrame
+*/
+void QSvgRenderer::renderAt(QPainter *painter, qint64 timeMs, const QRectF &bounds)
+{
+    Q_D(QSvgRenderer);
+    if (d->render) {
+        const int elapsed = int(qBound<qint64>(0, timeMs, std::numeric_limits<int>::max()));
+        d->render->drawAt(painter, elapsed, bounds, QRectF());
+    }
+}
+
 QRectF QSvgRenderer::viewBoxF() const
 {
     Q_D(const QSvgRenderer);
@@ -64,6 +64,7 @@ class Q_SVG_EXPORT QSvgRenderer : public QObject
     Q_PROPERTY(QRectF viewBox READ viewBoxF WRITE setViewBox)
     Q_PROPERTY(int framesPerSecond READ framesPerSecond WRITE setFramesPerSecond)
     Q_PROPERTY(int currentFrame READ currentFrame WRITE setCurrentFrame)
+    Q_PROPERTY(bool animationActive READ isAnimationActive WRITE setAnimationActive)
 public:
     QSvgRenderer(QObject *parent = nullptr);
     QSvgRenderer(const QString &filename, QObject *parent = nullptr);
@@ -86,6 +87,8 @@ public:
     int currentFrame() const;
     void setCurrentFrame(int);
     int animationDuration() const;//in seconds
+    bool isAnimationActive() const;
+    void setAnimationActive(bool active);
 
     QRectF boundsOnElement(const QString &id) const;
     bool elementExists(const QString &id) const;
@@ -103,10 +106,14 @@ public Q_SLOTS:
 
     void render(QPainter *p, const QString &elementId,
                 const QRectF &bounds=QRectF());
+    void renderAt(QPainter *p, qint64 timeMs, const QRectF &bounds=QRectF());
 
 Q_SIGNALS:
     void repaintNeeded();
 
+protected:
+    bool event(QEvent *event) override;
+
 private:
     Q_DECLARE_PRIVATE(QSvgRenderer)
 };
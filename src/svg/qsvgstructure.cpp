@@ -93,11 +93,13 @@ QSvgStructureNode::QSvgStructureNode(const QSvgStructureNode &other) : QSvgNode(
     m_renderers.reserve(other.m_renderers.size());
     for (QSvgNode *node : other.m_renderers)
         m_renderers.append((node)->clone(this));
+}
 
-    // m_scope
-    Q_ASSERT(m_scope.isEmpty());
-    // m_linkedScopes
-    Q_ASSERT(m_linkedScopes.isEmpty());
+void QSvgStructureNode::setDocument(QSvgTinyDocument *doc)
+{
+    QSvgNode::setDocument(doc);
+    for (QSvgNode *node : qAsConst(m_renderers))
+        node->setDocument(doc);
 }
 
 QSvgNode * QSvgStructureNode::scopeNode(const QString &id) const
@@ -382,13 +384,13 @@ void QSvgSwitch::init()
     m_systemLanguagePrefix = m_systemLanguage.mid(0, idx);
 }
 
-QRectF QSvgStructureNode::bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const
+QRectF QSvgStructureNode::bounds(const QSvgBoundsState &state, bool defaultViewCoord) const
 {
     QRectF bounds;
     if (!m_recursing) {
         QScopedValueRollback<bool> guard(m_recursing, true);
         for (QSvgNode *node : qAsConst(m_renderers))
-            bounds |= node->transformedBounds(p, states, defaultViewCoord);
+            bounds |= node->transformedBounds(state, defaultViewCoord);
     }
     return bounds;
 }
@@ -424,6 +426,8 @@ void QSvgMarker::draw(QPainter *p, QSvgExtraStates &states, const QPointF& point
     if (!isAutoOrient())
         angle = m_orientAngle;
 
+    // restore() must bring back the state the styles expect
+    states.painter.flush(p);
     p->save();
 
     qreal scale = 1.0;
@@ -576,6 +580,8 @@ QPixmap QSvgPattern::patternContentPixmap(QPainter *p, QSvgExtraStates &states)
     QPainter painter(&pixmap);
     painter.setRenderHint(QPainter::Antialiasing);
     painter.setBrush(QBrush(Qt::black));
+    // the content starts from the state of its own painter
+    states.painter.flush(p);
     auto itr = m_renderers.cbegin();
     while (itr != m_renderers.cend()) {
         QSvgNode *node = *itr;
@@ -586,6 +592,7 @@ QPixmap QSvgPattern::patternContentPixmap(QPainter *p, QSvgExtraStates &states)
         }
         ++itr;
     }
+    states.painter.discard();
     painter.end();
     return pixmap;
 }
@@ -601,6 +608,7 @@ void QSvgPattern::drawTile(QPainter *p, QSvgExtraStates &states)
     }
 
     applyStyle(p, states);
+    states.painter.flush(p);
     p->setRenderHint(QPainter::SmoothPixmapTransform, false);
     p->setRenderHint(QPainter::HighQualityPixmapTransform, false);
     p->setClipping(true);
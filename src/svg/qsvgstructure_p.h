@@ -72,13 +72,12 @@ public:
     ~QSvgStructureNode();
     QSvgNode *scopeNode(const QString &id) const;
     void addChild(QSvgNode *child, const QString &id);
-    QRectF bounds(QPainter *p, QSvgExtraStates &states, bool defaultViewCoord) const override;
+    QRectF bounds(const QSvgBoundsState &state, bool defaultViewCoord) const override;
     QSvgNode *previousSiblingNode(QSvgNode *n) const;
     const QList<QSvgNode*>& renderers() const { return m_renderers; }
+    void setDocument(QSvgTinyDocument *doc) override;
 protected:
     QList<QSvgNode*>          m_renderers;
-    QHash<QString, QSvgNode*> m_scope;
-    QList<QSvgStructureNode*> m_linkedScopes;
     mutable bool              m_recursing = false;
 };
 
@@ -63,6 +63,27 @@ QSvgExtraStates::QSvgExtraStates()
     , fillRule(Qt::WindingFill)
     , strokeDashOffset(0)
     , vectorEffect(false)
+    , animationTime(-1)
+{
+}
+
+void QSvgPainterState::flush(QPainter *p)
+{
+    if ((m_pending & PenPending) && p->pen() != m_pen)
+        p->setPen(m_pen);
+    if ((m_pending & BrushPending) && p->brush() != m_brush)
+        p->setBrush(m_brush);
+    if ((m_pending & FontPending) && p->font() != m_font)
+        p->setFont(m_font);
+    if (m_pending & OpacityPending)
+        p->setOpacity(m_opacity);
+    m_pending = 0;
+}
+
+QSvgBoundsState::QSvgBoundsState()
+    : penWidth(1.0)
+    , stroked(false)
+    , cosmetic(false)
 {
 }
 
@@ -134,7 +155,7 @@ void QSvgFillStyle::setBrush(QBrush brush)
 
 void QSvgFillStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states)
 {
-    m_oldFill = p->brush();
+    m_oldFill = states.painter.brush(p);
     m_oldFillRule = states.fillRule;
     m_oldFillOpacity = states.fillOpacity;
 
@@ -142,20 +163,20 @@ void QSvgFillStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states
         states.fillRule = m_fillRule;
     if (m_fillSet) {
         if (m_style)
-            p->setBrush(m_style->brush(p, states));
+            states.painter.setBrush(m_style->brush(p, states));
         else
-            p->setBrush(m_fill);
+            states.painter.setBrush(m_fill);
     }
     if (m_fillOpacitySet)
         states.fillOpacity = m_fillOpacity;
 }
 
-void QSvgFillStyle::revert(QPainter *p, QSvgExtraStates &states)
+void QSvgFillStyle::revert(QPainter *, QSvgExtraStates &states)
 {
     if (m_fillOpacitySet)
         states.fillOpacity = m_oldFillOpacity;
     if (m_fillSet)
-        p->setBrush(m_oldFill);
+        states.painter.setBrush(m_oldFill);
     if (m_fillRuleSet)
         states.fillRule = m_oldFillRule;
 }
@@ -165,15 +186,15 @@ QSvgViewportFillStyle::QSvgViewportFillStyle(const QBrush &brush)
 {
 }
 
-void QSvgViewportFillStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &)
+void QSvgViewportFillStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states)
 {
-    m_oldFill = p->brush();
-    p->setBrush(m_viewportFill);
+    m_oldFill = states.painter.brush(p);
+    states.painter.setBrush(m_viewportFill);
 }
 
-void QSvgViewportFillStyle::revert(QPainter *p, QSvgExtraStates &)
+void QSvgViewportFillStyle::revert(QPainter *, QSvgExtraStates &states)
 {
-    p->setBrush(m_oldFill);
+    states.painter.setBrush(m_oldFill);
 }
 
 QSvgFontStyle::QSvgFontStyle(QSvgFont *font, QSvgTinyDocument *doc)
@@ -230,7 +251,7 @@ bool QSvgFontStyle::isValidFamily(const QString &family)
 
 void QSvgFontStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states)
 {
-    m_oldQFont = p->font();
+    m_oldQFont = states.painter.font(p);
     m_oldSvgFont = states.svgFont;
     m_oldTextAnchor = states.textAnchor;
     m_oldWeight = states.fontWeight;
@@ -266,12 +287,12 @@ void QSvgFontStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states
         font.setWeight(SVGToQtWeight(states.fontWeight));
     }
 
-    p->setFont(font);
+    states.painter.setFont(font);
 }
 
-void QSvgFontStyle::revert(QPainter *p, QSvgExtraStates &states)
+void QSvgFontStyle::revert(QPainter *, QSvgExtraStates &states)
 {
-    p->setFont(m_oldQFont);
+    states.painter.setFont(m_oldQFont);
     states.svgFont = m_oldSvgFont;
     states.textAnchor = m_oldTextAnchor;
     states.fontWeight = m_oldWeight;
@@ -300,12 +321,12 @@ QSvgStrokeStyle::QSvgStrokeStyle()
 
 void QSvgStrokeStyle::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &states)
 {
-    m_oldStroke = p->pen();
+    m_oldStroke = states.painter.pen(p);
     m_oldStrokeOpacity = states.strokeOpacity;
     m_oldStrokeDashOffset = states.strokeDashOffset;
     m_oldVectorEffect = states.vectorEffect;
 
-    QPen pen = p->pen();
+    QPen pen = m_oldStroke;
 
     qreal oldWidth = pen.widthF();
     qreal width = m_stroke.widthF();
@@ -328,18 +349,8 @@ void QSvgStrokeStyle::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &
             pen.setBrush(m_stroke.brush());
     }
 
-    if (m_strokeWidthSet) {
-        qreal strokeWidth = m_stroke.widthF();
-
-        if (node->document()->viewBoxValid() && node->cacheBounds().isValid()) {
-            QRectF viewBox = node->document()->viewBox();
-
-            if (viewBox.contains(node->cacheBounds().center()))
-                strokeWidth = qMin(strokeWidth, 2.0 * qMax(viewBox.width(), viewBox.height()));
-        }
-
-        pen.setWidthF(strokeWidth);
-    }
+    if (m_strokeWidthSet)
+        pen.setWidthF(effectiveWidth(node, true));
 
     bool setDashOffsetNeeded = false;
 
@@ -391,12 +402,45 @@ void QSvgStrokeStyle::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &
 
     pen.setCosmetic(states.vectorEffect);
 
-    p->setPen(pen);
+    states.painter.setPen(pen);
+}
+
+void QSvgStrokeStyle::applyBounds(const QSvgNode *node, QSvgBoundsState &state) const
+{
+    if (m_strokeSet)
+        state.stroked = m_style || m_stroke.brush().style() != Qt::NoBrush;
+    if (m_strokeWidthSet)
+        state.penWidth = effectiveWidth(node, false);
+    if (m_vectorEffectSet)
+        state.cosmetic = m_vectorEffect;
+}
+
+qreal QSvgStrokeStyle::effectiveWidth(const QSvgNode *node, bool resolveBounds) const
+{
+    qreal strokeWidth = m_stroke.widthF();
+
+    const QSvgTinyDocument *doc = node->document();
+    if (!doc->viewBoxValid())
+        return strokeWidth;
+
+    // Only strokes wider than the clamp need the node bounds, so the bounds
+    // of the document are resolved on demand rather than on first render.
+    QRectF viewBox = doc->viewBox();
+    qreal maxWidth = 2.0 * qMax(viewBox.width(), viewBox.height());
+    if (strokeWidth <= maxWidth)
+        return strokeWidth;
+
+    if (resolveBounds)
+        doc->ensureBoundsCached();
+    if (node->cacheBounds().isValid() && viewBox.contains(node->cacheBounds().center()))
+        strokeWidth = maxWidth;
+
+    return strokeWidth;
 }
 
-void QSvgStrokeStyle::revert(QPainter *p, QSvgExtraStates &states)
+void QSvgStrokeStyle::revert(QPainter *, QSvgExtraStates &states)
 {
-    p->setPen(m_oldStroke);
+    states.painter.setPen(m_oldStroke);
     states.strokeOpacity = m_oldStrokeOpacity;
     states.strokeDashOffset = m_oldStrokeDashOffset;
     states.vectorEffect = m_oldVectorEffect;
@@ -586,25 +630,9 @@ QSvgStyleProperty::Type QSvgClipPathStyle::type() const
     return CLIPPATH;
 }
 
-static bool isParentStyle(const QSvgNode *node, const QString &id)
+void QSvgClipPathStyle::setClipPathNode(QSvgClipPath *clipNode)
 {
-    QSvgNode *parent = node->parent();
-    if (!parent)
-        return false;
-    if (id == parent->nodeId())
-        return true;
-    return isParentStyle(parent, id);
-}
-
-void QSvgClipPathStyle::setClipPathNode(const QSvgNode *userNode) 
-{
-    if (nullptr == userNode || nullptr == userNode->document()
-        || nullptr == userNode->document()->namedNode(m_clipId)
-        || QSvgNode::CLIPPATH != userNode->document()->namedNode(m_clipId)->type())
-        return;
-
-    if (!isParentStyle(userNode, m_clipId))
-        m_clipNode = static_cast<QSvgClipPath *>(userNode->document()->namedNode(m_clipId));
+    m_clipNode = clipNode;
 }
 
 QSvgStyle::~QSvgStyle()
@@ -644,7 +672,7 @@ void QSvgStyle::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &states
     //animated transforms have to be applied
     //_after_ the original object transformations
     if (!animateTransforms.isEmpty()) {
-        qreal totalTimeElapsed = node->document()->currentElapsed();
+        qreal totalTimeElapsed = states.animationTime;
         // Find the last animateTransform with additive="replace", since this will override all
         // previous animateTransforms.
         QList<QSvgRefCounter<QSvgAnimateTransform> >::const_iterator itr = animateTransforms.constEnd();
@@ -679,6 +707,36 @@ void QSvgStyle::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &states
     }
 }
 
+void QSvgStyle::applyBounds(const QSvgNode *node, QSvgBoundsState &state)
+{
+    if (stroke)
+        stroke->applyBounds(node, state);
+
+    const QTransform baseTransform = state.transform;
+    if (transform)
+        state.transform = transform->qtransform() * state.transform;
+
+    // Same rules as apply(): a running additive="replace" animation drops the
+    // transform attribute, and everything from it onwards is applied.
+    if (!animateTransforms.isEmpty()) {
+        qreal totalTimeElapsed = node->document()->currentElapsed();
+        QList<QSvgRefCounter<QSvgAnimateTransform> >::const_iterator itr = animateTransforms.constEnd();
+        do {
+            --itr;
+            if ((*itr)->animActive(totalTimeElapsed)
+                && (*itr)->additiveType() == QSvgAnimateTransform::Replace) {
+                state.transform = baseTransform;
+                break;
+            }
+        } while (itr != animateTransforms.constBegin());
+
+        for (; itr != animateTransforms.constEnd(); ++itr) {
+            if ((*itr)->animActive(totalTimeElapsed))
+                (*itr)->applyBounds(node, state);
+        }
+    }
+}
+
 void QSvgStyle::revert(QPainter *p, QSvgExtraStates &states)
 {
     if (quality) {
@@ -743,7 +801,6 @@ QSvgAnimateTransform::QSvgAnimateTransform(int startMs, int endMs, int byMs )
       m_type(Empty),
       m_additive(Replace),
       m_count(0),
-      m_finished(false),
       m_freeze(false),
       m_repeatCount(-1.),
       m_transformApplied(false)
@@ -760,35 +817,40 @@ void QSvgAnimateTransform::setArgs(TransformType type, Additive additive, const
     m_count = args.count() / 3;
 }
 
-void QSvgAnimateTransform::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &)
+void QSvgAnimateTransform::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states)
 {
     m_oldWorldTransform = p->worldTransform();
-    resolveMatrix(node);
+    resolveMatrix(states.animationTime);
     p->setWorldTransform(m_transform, true);
     m_transformApplied = true;
 }
 
+void QSvgAnimateTransform::applyBounds(const QSvgNode *node, QSvgBoundsState &state)
+{
+    resolveMatrix(node->document()->currentElapsed());
+    state.transform = m_transform * state.transform;
+}
+
 void QSvgAnimateTransform::revert(QPainter *p, QSvgExtraStates &)
 {
     p->setWorldTransform(m_oldWorldTransform, false /* don't combine */);
     m_transformApplied = false;
 }
 
-void QSvgAnimateTransform::resolveMatrix(const QSvgNode *node)
+void QSvgAnimateTransform::resolveMatrix(qreal totalTimeElapsed)
 {
     static const qreal deg2rad = qreal(0.017453292519943295769);
-    qreal totalTimeElapsed = node->document()->currentElapsed();
-    if (totalTimeElapsed < m_from || m_finished)
+    if (totalTimeElapsed < m_from)
         return;
 
+    // The matrix only depends on the given time, so frames can be
+    // resolved in any order.
     qreal animationFrame = 0;
     if (m_totalRunningTime != 0) {
         animationFrame = (totalTimeElapsed - m_from) / m_totalRunningTime;
 
-        if (m_repeatCount >= 0 && m_repeatCount < animationFrame) {
-            m_finished = true;
+        if (m_repeatCount >= 0 && m_repeatCount < animationFrame)
             animationFrame = m_repeatCount;
-        }
     }
 
     qreal percentOfAnimation = animationFrame;
@@ -919,7 +981,6 @@ QSvgAnimateColor::QSvgAnimateColor(int startMs, int endMs, int byMs)
       m_from(startMs),
       m_totalRunningTime(endMs - startMs),
       m_fill(false),
-      m_finished(false),
       m_freeze(false),
       m_repeatCount(-1.)
 {
@@ -943,10 +1004,15 @@ void QSvgAnimateColor::setRepeatCount(qreal repeatCount)
     m_repeatCount = repeatCount;
 }
 
-void QSvgAnimateColor::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &)
+void QSvgAnimateColor::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states)
 {
-    qreal totalTimeElapsed = node->document()->currentElapsed();
-    if (totalTimeElapsed < m_from || m_finished)
+    if (m_fill)
+        m_oldBrush = states.painter.brush(p);
+    else
+        m_oldPen = states.painter.pen(p);
+
+    qreal totalTimeElapsed = states.animationTime;
+    if (totalTimeElapsed < m_from)
         return;
 
     qreal animationFrame = 0;
@@ -954,7 +1020,8 @@ void QSvgAnimateColor::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates
         animationFrame = (totalTimeElapsed - m_from) / m_totalRunningTime;
 
     if (m_repeatCount >= 0 && m_repeatCount < animationFrame) {
-        m_finished = true;
+        if (!m_freeze)
+            return;
         animationFrame = m_repeatCount;
     }
 
@@ -989,24 +1056,22 @@ void QSvgAnimateColor::apply(QPainter *p, const QSvgNode *node, QSvgExtraStates
     QColor color(red, green, blue, alpha);
 
     if (m_fill) {
-        QBrush b = p->brush();
-        m_oldBrush = b;
+        QBrush b = m_oldBrush;
         b.setColor(color);
-        p->setBrush(b);
+        states.painter.setBrush(b);
     } else {
-        QPen pen = p->pen();
-        m_oldPen = pen;
+        QPen pen = m_oldPen;
         pen.setColor(color);
-        p->setPen(pen);
+        states.painter.setPen(pen);
     }
 }
 
-void QSvgAnimateColor::revert(QPainter *p, QSvgExtraStates &)
+void QSvgAnimateColor::revert(QPainter *, QSvgExtraStates &states)
 {
     if (m_fill) {
-        p->setBrush(m_oldBrush);
+        states.painter.setBrush(m_oldBrush);
     } else {
-        p->setPen(m_oldPen);
+        states.painter.setPen(m_oldPen);
     }
 }
 
@@ -1021,15 +1086,15 @@ QSvgOpacityStyle::QSvgOpacityStyle(qreal opacity)
 
 }
 
-void QSvgOpacityStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &)
+void QSvgOpacityStyle::apply(QPainter *p, const QSvgNode *, QSvgExtraStates &states)
 {
-    m_oldOpacity = p->opacity();
-    p->setOpacity(m_opacity * m_oldOpacity);
+    m_oldOpacity = states.painter.opacity(p);
+    states.painter.setOpacity(m_opacity * m_oldOpacity);
 }
 
-void QSvgOpacityStyle::revert(QPainter *p, QSvgExtraStates &)
+void QSvgOpacityStyle::revert(QPainter *, QSvgExtraStates &states)
 {
-    p->setOpacity(m_oldOpacity);
+    states.painter.setOpacity(m_oldOpacity);
 }
 
 QSvgStyleProperty::Type QSvgOpacityStyle::type() const
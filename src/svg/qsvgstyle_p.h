@@ -135,6 +135,45 @@ private:
     int _ref;
 };
 
+// The pen, brush, font and opacity the styles want on the painter. Styles
+// only record them here, and nodes push them with flush() right before they
+// draw, so a revert followed by an equal apply between siblings never reaches
+// QPainter. QPainter marks the engine's brush and font state dirty on every
+// setBrush() and setFont(), even for an equal value.
+class Q_SVG_PRIVATE_EXPORT QSvgPainterState
+{
+public:
+    QSvgPainterState() : m_opacity(1.0), m_pending(0) {}
+
+    QPen pen(const QPainter *p) const { return (m_pending & PenPending) ? m_pen : p->pen(); }
+    QBrush brush(const QPainter *p) const { return (m_pending & BrushPending) ? m_brush : p->brush(); }
+    QFont font(const QPainter *p) const { return (m_pending & FontPending) ? m_font : p->font(); }
+    qreal opacity(const QPainter *p) const { return (m_pending & OpacityPending) ? m_opacity : p->opacity(); }
+
+    void setPen(const QPen &pen) { m_pen = pen; m_pending |= PenPending; }
+    void setBrush(const QBrush &brush) { m_brush = brush; m_pending |= BrushPending; }
+    void setFont(const QFont &font) { m_font = font; m_pending |= FontPending; }
+    void setOpacity(qreal opacity) { m_opacity = opacity; m_pending |= OpacityPending; }
+
+    void flush(QPainter *p);
+    // drops the pending values, for when the painter changes underneath
+    void discard() { m_pending = 0; }
+
+private:
+    enum {
+        PenPending = 0x1,
+        BrushPending = 0x2,
+        FontPending = 0x4,
+        OpacityPending = 0x8
+    };
+
+    QPen m_pen;
+    QBrush m_brush;
+    QFont m_font;
+    qreal m_opacity;
+    uint m_pending;
+};
+
 struct Q_SVG_PRIVATE_EXPORT QSvgExtraStates
 {
     QSvgExtraStates();
@@ -147,6 +186,21 @@ struct Q_SVG_PRIVATE_EXPORT QSvgExtraStates
     Qt::FillRule fillRule;
     qreal strokeDashOffset;
     bool vectorEffect; // true if pen is cosmetic
+    int animationTime; // ms into the animation, -1 if not animated
+    QSvgPainterState painter;
+};
+
+// Geometry-only counterpart of the painter state, used for bounds calculation.
+struct Q_SVG_PRIVATE_EXPORT QSvgBoundsState
+{
+    QSvgBoundsState();
+
+    qreal strokeWidth() const { return (stroked && !cosmetic) ? penWidth : 0; }
+
+    QTransform transform;
+    qreal penWidth;
+    bool stroked;  // stroke paint is not 'none'
+    bool cosmetic; // vector-effect="non-scaling-stroke"
 };
 
 class Q_SVG_PRIVATE_EXPORT QSvgStyleProperty : public QSvgRefCounted
@@ -465,6 +519,7 @@ public:
     void apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &states) override;
     void revert(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
+    void applyBounds(const QSvgNode *node, QSvgBoundsState &state) const;
 
     void setStroke(QBrush brush)
     {
@@ -590,6 +645,8 @@ public:
     bool isVectorEffectSet() const { return m_vectorEffectSet; }
 
 private:
+    qreal effectiveWidth(const QSvgNode *node, bool resolveBounds) const;
+
     // stroke            v     v     'inherit' | <Paint.datatype>
     // stroke-dasharray  v     v     'inherit' | <StrokeDashArrayValue.datatype>
     // stroke-dashoffset v     v     'inherit' | <StrokeDashOffsetValue.datatype>
@@ -753,6 +810,7 @@ public:
     void apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &states) override;
     void revert(QPainter *p, QSvgExtraStates &states) override;
     Type type() const override;
+    void applyBounds(const QSvgNode *node, QSvgBoundsState &state);
     QSvgAnimateTransform::Additive additiveType() const
     {
         return m_additive;
@@ -784,7 +842,7 @@ public:
     }
 
 protected:
-    void resolveMatrix(const QSvgNode *node);
+    void resolveMatrix(qreal totalTimeElapsed);
 private:
     qreal m_from;
     qreal m_totalRunningTime;
@@ -794,7 +852,6 @@ private:
     int m_count;
     QTransform m_transform;
     QTransform m_oldWorldTransform;
-    bool m_finished;
     bool m_freeze;
     qreal m_repeatCount;
     bool m_transformApplied;
@@ -818,7 +875,6 @@ private:
     QBrush m_oldBrush;
     QPen   m_oldPen;
     bool m_fill;
-    bool m_finished;
     bool m_freeze;
     qreal m_repeatCount;
 };
@@ -852,7 +908,7 @@ public:
     Type type() const override;
 
     const QString& clipPathId() const { return m_clipId; }
-    void setClipPathNode(const QSvgNode *userNode);
+    void setClipPathNode(QSvgClipPath *clipNode);
     const QSvgClipPath *getClipNode() const { return m_clipNode; }
 
     void initCurrePath(QRectF bounds);
@@ -887,6 +943,7 @@ public:
 
     void apply(QPainter *p, const QSvgNode *node, QSvgExtraStates &states);
     void revert(QPainter *p, QSvgExtraStates &states);
+    void applyBounds(const QSvgNode *node, QSvgBoundsState &state);
     QSvgRefCounter<QSvgQualityStyle>      quality;
     QSvgRefCounter<QSvgFillStyle>         fill;
     QSvgRefCounter<QSvgViewportFillStyle> viewportFill;
@@ -902,6 +959,19 @@ public:
     QSvgRefCounter<QSvgClipPathStyle>     clipPath;
 };
 
+// The properties QSvgNode::styleProperty() finds for a node, precomputed by
+// QSvgTinyDocument::computeStyles(). The node styles own the properties.
+struct QSvgComputedStyle
+{
+    QSvgFillStyle *fill = nullptr;
+    QSvgStrokeStyle *stroke = nullptr;
+    QSvgFontStyle *font = nullptr;
+    QSvgTransformStyle *transform = nullptr;
+    QSvgOpacityStyle *opacity = nullptr;
+    QSvgClipPathStyle *clipPath = nullptr;
+};
+Q_DECLARE_TYPEINFO(QSvgComputedStyle, Q_MOVABLE_TYPE);
+
 /********************************************************/
 // NOT implemented:
 
@@ -43,11 +43,13 @@
 #include "qsvgfont_p.h"
 
 #include "qpainter.h"
+#include "qpaintengine.h"
 #include "qfile.h"
 #include "qbuffer.h"
 #include "qbytearray.h"
 #include "qqueue.h"
 #include "qstack.h"
+#include "qset.h"
 #include "qdebug.h"
 #if defined(Q_OS_ANDROID)
 #include "qscopedvaluerollback.h"
@@ -59,23 +61,6 @@
 
 QT_BEGIN_NAMESPACE
 
-static void initNamedNodes(const QList<QSvgNode *> &renders, QHash<QString, QSvgNode *> &namedNodes)
-{
-    for (QSvgNode *node : renders) {
-        if (!node->nodeId().isEmpty())
-            namedNodes.insert(node->nodeId(), node);
-
-        switch (node->type()) {
-        case QSvgNode::G:
-        case QSvgNode::DEFS:
-        case QSvgNode::SWITCH:
-            initNamedNodes((static_cast<QSvgStructureNode *>(node))->renderers(), namedNodes);
-        default:
-            break;
-        }
-    }
-}
-
 static void resolvedPatternLink(const QList<QSvgNode *> &renders, QSvgTinyDocument *doc)
 {
     for (QSvgNode *node : renders) {
@@ -100,10 +85,11 @@ QSvgTinyDocument::QSvgTinyDocument(QSvgNode *parent /*= nullptr*/)
       m_widthPercent(false),
       m_heightPercent(false),
       m_animated(false),
-      m_firstRender(true),
+      m_boundsCached(false),
       m_animationDuration(0),
       m_fps(30)
 {
+    QSvgNode::setDocument(this);
 }
 QSvgTinyDocument::QSvgTinyDocument(const QSvgTinyDocument &other)
     : QSvgStructureNode(other),
@@ -111,9 +97,11 @@ QSvgTinyDocument::QSvgTinyDocument(const QSvgTinyDocument &other)
       m_size(other.m_size),
       m_widthPercent(other.m_widthPercent),
       m_heightPercent(other.m_heightPercent),
-      m_firstRender(other.m_firstRender),
+      m_boundsCached(other.m_boundsCached),
       m_viewBox(other.m_viewBox),
       m_fonts(other.m_fonts),
+      m_namedNodes(other.m_namedNodes),
+      m_nodeHandles(other.m_nodeHandles.size(), nullptr),
       m_namedStyles(other.m_namedStyles),
       m_time(other.m_time),
       m_animated(other.m_animated),
@@ -121,10 +109,16 @@ QSvgTinyDocument::QSvgTinyDocument(const QSvgTinyDocument &other)
       m_fps(other.m_fps),
       m_states(other.m_states),
       m_svgProp(other.m_svgProp),
-      m_xmlClassList(other.m_xmlClassList)
-{
-    m_namedNodes.reserve(other.m_namedNodes.size());
-    initNamedNodes(m_renderers, m_namedNodes);
+      m_xmlClassList(other.m_xmlClassList),
+      m_staticLayersEnabled(other.m_staticLayersEnabled)
+{
+    // the cloned children still point to the other document, telling them
+    // about this one also puts them behind the ids they had over there
+    m_document = this;
+    m_adoptingNodes = true;
+    for (QSvgNode *node : qAsConst(m_renderers))
+        node->setDocument(this);
+    m_adoptingNodes = false;
     Q_ASSERT(m_renderers.size() == other.m_renderers.size());
 
     // fix doc-pointer for unresloved gradient link
@@ -138,10 +132,21 @@ QSvgTinyDocument::QSvgTinyDocument(const QSvgTinyDocument &other)
     }
     
     resolvedPatternLink(m_renderers, this);
+
+    if (!other.m_computedStyles.isEmpty())
+        computeStyles();
 }
 
 QSvgTinyDocument::~QSvgTinyDocument() {}
 
+void QSvgTinyDocument::setDocument(QSvgTinyDocument *doc)
+{
+    // a document is always its own, also when nested in another one, but
+    // its id belongs to the outer document
+    if (m_idHandle >= 0 && doc)
+        doc->adoptNamedNode(this);
+}
+
 #ifndef QT_NO_COMPRESS
 static QByteArray qt_inflateSvgzDataFrom(QIODevice *device, bool doCheckContent = true);
 #   ifdef QT_BUILD_INTERNAL
@@ -366,14 +371,18 @@ void QSvgTinyDocument::draw(QPainter *p, const QRectF &bounds, const QRectF & so
         m_time.start();
     }
 
+    drawAt(p, currentElapsed(), bounds, source);
+}
+
+// Draws the document with its animations evaluated at \a elapsed ms,
+// independent of the animation clock.
+void QSvgTinyDocument::drawAt(QPainter *p, int elapsed, const QRectF &bounds, const QRectF &source)
+{
     if (displayMode() == QSvgNode::NoneMode)
         return;
 
-    // make sure all node's cachebound valid
-    if (m_firstRender) {
-        m_firstRender = false;
-        transformedBounds();
-    }
+    m_states.animationTime = m_animated ? elapsed : -1;
+    m_states.painter.discard();
 
     p->save();
     if (nullptr == parent()) {
@@ -398,18 +407,135 @@ void QSvgTinyDocument::draw(QPainter *p, const QRectF &bounds, const QRectF & so
         mapSourceToTarget(p, QRectF(m_coord, size()), viewBox());
     }
 
-    QList<QSvgNode *>::iterator itr = m_renderers.begin();
     applyStyle(p, m_states);
-    while (itr != m_renderers.end()) {
-        QSvgNode *node = *itr;
-        if ((node->isVisible()) && (node->displayMode() != QSvgNode::NoneMode))
-            node->draw(p, m_states);
-        ++itr;
+    m_states.painter.flush(p);
+    if (canUseStaticLayers(p)) {
+        drawWithStaticLayers(p);
+    } else {
+        QList<QSvgNode *>::iterator itr = m_renderers.begin();
+        while (itr != m_renderers.end()) {
+            QSvgNode *node = *itr;
+            if ((node->isVisible()) && (node->displayMode() != QSvgNode::NoneMode))
+                node->draw(p, m_states);
+            ++itr;
+        }
     }
     revertStyle(p, m_states);
     p->restore();
 }
 
+bool QSvgTinyDocument::canUseStaticLayers(QPainter *p) const
+{
+    // Layers are composited with SourceOver, which only matches drawing the
+    // nodes directly on a raster target with no painter opacity in effect.
+    if (!m_animated || !m_staticLayersEnabled || parent())
+        return false;
+    if (!p->paintEngine() || p->paintEngine()->type() != QPaintEngine::Raster)
+        return false;
+    if (p->opacity() != 1.0 || p->compositionMode() != QPainter::CompositionMode_SourceOver)
+        return false;
+
+    const QPaintDevice *dev = p->device();
+    const qreal dpr = dev->devicePixelRatioF();
+    const qint64 pixels = qint64(dev->width() * dpr) * qint64(dev->height() * dpr);
+    return pixels > 0 && pixels <= 4096 * 4096;
+}
+
+// Two sets of layers keep two views of different sizes sharing a renderer
+// from rendering them again for every frame.
+static const int qsvg_maxStaticLayerSets = 2;
+
+void QSvgTinyDocument::drawWithStaticLayers(QPainter *p)
+{
+    const QPaintDevice *dev = p->device();
+    const QSize layerSize = QSize(dev->width(), dev->height()) * dev->devicePixelRatioF();
+    const QTransform transform = p->combinedTransform();
+    const QPainter::RenderHints hints = p->renderHints();
+
+    // Static nodes between animated ones are drawn directly, merging them
+    // into a layer would change the stacking order.
+    const int count = m_renderers.size();
+    int first = 0;
+    while (first < count && !m_renderers.at(first)->isSubtreeAnimated())
+        ++first;
+    int last = count;
+    while (last > first && !m_renderers.at(last - 1)->isSubtreeAnimated())
+        --last;
+
+    int index = 0;
+    while (index < m_staticLayers.size()) {
+        const StaticLayers &layers = m_staticLayers.at(index);
+        if (layers.size == layerSize && layers.transform == transform && layers.hints == hints)
+            break;
+        ++index;
+    }
+    if (index == m_staticLayers.size()) {
+        StaticLayers layers;
+        layers.size = layerSize;
+        layers.transform = transform;
+        layers.hints = hints;
+        layers.background = renderStaticLayer(p, 0, first, layerSize);
+        layers.foreground = renderStaticLayer(p, last, count, layerSize);
+        if (m_staticLayers.size() == qsvg_maxStaticLayerSets)
+            m_staticLayers.removeLast();
+        m_staticLayers.prepend(layers);
+    } else if (index > 0) {
+        m_staticLayers.move(index, 0);
+    }
+
+    const StaticLayers &layers = m_staticLayers.first();
+    if (!layers.background.isNull()) {
+        p->save();
+        p->resetTransform();
+        p->drawImage(QPointF(0, 0), layers.background);
+        p->restore();
+    }
+
+    for (int i = first; i < last; ++i) {
+        QSvgNode *node = m_renderers.at(i);
+        if (node->isVisible() && node->displayMode() != QSvgNode::NoneMode)
+            node->draw(p, m_states);
+    }
+
+    if (!layers.foreground.isNull()) {
+        p->save();
+        p->resetTransform();
+        p->drawImage(QPointF(0, 0), layers.foreground);
+        p->restore();
+    }
+}
+
+QImage QSvgTinyDocument::renderStaticLayer(QPainter *p, int begin, int end, const QSize &size)
+{
+    bool empty = true;
+    for (int i = begin; i < end && empty; ++i) {
+        const QSvgNode *node = m_renderers.at(i);
+        empty = !node->isVisible() || node->displayMode() == QSvgNode::NoneMode;
+    }
+    if (empty)
+        return QImage();
+
+    QImage layer(size, QImage::Format_ARGB32_Premultiplied);
+    layer.setDevicePixelRatio(p->device()->devicePixelRatioF());
+    layer.fill(Qt::transparent);
+
+    QPainter layerPainter(&layer);
+    layerPainter.setRenderHints(p->renderHints());
+    m_states.painter.flush(p);
+    layerPainter.setPen(p->pen());
+    layerPainter.setBrush(p->brush());
+    layerPainter.setFont(p->font());
+    layerPainter.setWorldTransform(p->combinedTransform());
+    for (int i = begin; i < end; ++i) {
+        QSvgNode *node = m_renderers.at(i);
+        if (node->isVisible() && node->displayMode() != QSvgNode::NoneMode)
+            node->draw(&layerPainter, m_states);
+    }
+    m_states.painter.discard();
+    layerPainter.end();
+    return layer;
+}
+
 
 void QSvgTinyDocument::draw(QPainter *p, const QString &id,
                             const QRectF &bounds)
@@ -427,6 +553,9 @@ void QSvgTinyDocument::draw(QPainter *p, const QString &id,
     if (node->displayMode() == QSvgNode::NoneMode)
         return;
 
+    m_states.animationTime = currentElapsed();
+    m_states.painter.discard();
+
     p->save();
 
     const QRectF elementBounds = node->transformedBounds();
@@ -520,6 +649,16 @@ void QSvgTinyDocument::setViewBox(const QRectF &rect)
     m_viewBox = rect;
 }
 
+// Fills the bounds cache of every node in one pass over the tree. This is
+// only needed by consumers of cacheBounds(), so it is not done up front.
+void QSvgTinyDocument::ensureBoundsCached() const
+{
+    if (m_boundsCached)
+        return;
+    m_boundsCached = true;
+    transformedBounds();
+}
+
 void QSvgTinyDocument::addSvgFont(QSvgFont *font)
 {
     m_fonts.insert(font->familyName(), font);
@@ -532,12 +671,26 @@ QSvgFont * QSvgTinyDocument::svgFont(const QString &family) const
 
 void QSvgTinyDocument::addNamedNode(const QString &id, QSvgNode *node)
 {
-    m_namedNodes.insert(id, node);
+    int handle = node->m_idHandle;
+    if (handle < 0 || handle >= m_nodeHandles.size() || m_nodeHandles.at(handle) != node) {
+        handle = m_nodeHandles.size();
+        m_nodeHandles.append(node);
+        node->m_idHandle = handle;
+    }
+    m_namedNodes.insert(id, handle);
+}
+
+void QSvgTinyDocument::adoptNamedNode(QSvgNode *node)
+{
+    const int handle = node->m_idHandle;
+    if (m_adoptingNodes && handle < m_nodeHandles.size() && !m_nodeHandles.at(handle))
+        m_nodeHandles[handle] = node;
 }
 
 QSvgNode *QSvgTinyDocument::namedNode(const QString &id) const
 {
-    return m_namedNodes.value(id);
+    const int handle = m_namedNodes.value(id, -1);
+    return handle < 0 ? nullptr : m_nodeHandles.at(handle);
 }
 
 void QSvgTinyDocument::addNamedStyle(const QString &id, QSvgFillStyleProperty *style)
@@ -553,6 +706,105 @@ QSvgFillStyleProperty *QSvgTinyDocument::namedStyle(const QString &id) const
     return m_namedStyles.value(id);
 }
 
+template <class T>
+static inline T *ownOrInherited(const QSvgRefCounter<T> &own, T *inherited)
+{
+    return own ? static_cast<T *>(own) : inherited;
+}
+
+// Precomputes the fill, stroke, font, transform, opacity and clip path that
+// QSvgNode::styleProperty() returns for each node, so that it no longer walks
+// the parents. Appending a style property drops the table again, and nodes
+// of nested documents keep looking their properties up.
+void QSvgTinyDocument::computeStyles()
+{
+    m_computedStyles.clear();
+
+    // the root inherits whatever lies above it
+    QSvgComputedStyle rootStyle;
+    rootStyle.fill = static_cast<QSvgFillStyle *>(styleProperty(QSvgStyleProperty::FILL));
+    rootStyle.stroke = static_cast<QSvgStrokeStyle *>(styleProperty(QSvgStyleProperty::STROKE));
+    rootStyle.font = static_cast<QSvgFontStyle *>(styleProperty(QSvgStyleProperty::FONT));
+    rootStyle.transform = static_cast<QSvgTransformStyle *>(styleProperty(QSvgStyleProperty::TRANSFORM));
+    rootStyle.opacity = static_cast<QSvgOpacityStyle *>(styleProperty(QSvgStyleProperty::OPACITY));
+    rootStyle.clipPath = m_style.clipPath;
+    m_computedStyle = 0;
+    m_computedStyles.append(rootStyle);
+
+    QVector<QPair<QSvgNode *, int> > pending;
+    pending.append(qMakePair(static_cast<QSvgNode *>(this), 0));
+    while (!pending.isEmpty()) {
+        const QPair<QSvgNode *, int> item = pending.takeLast();
+        QSvgNode *node = item.first;
+
+        if (node != this) {
+            // nested documents index into their own table
+            if (node->type() == QSvgNode::DOC)
+                continue;
+
+            // lookups stop after defs and clip paths
+            QSvgComputedStyle inherited;
+            if (node->type() != QSvgNode::DEFS && node->type() != QSvgNode::CLIPPATH)
+                inherited = m_computedStyles.at(item.second);
+
+            const QSvgStyle &style = node->m_style;
+            QSvgComputedStyle computed;
+            computed.fill = ownOrInherited(style.fill, inherited.fill);
+            computed.stroke = ownOrInherited(style.stroke, inherited.stroke);
+            computed.font = ownOrInherited(style.font, inherited.font);
+            computed.transform = ownOrInherited(style.transform, inherited.transform);
+            computed.opacity = ownOrInherited(style.opacity, inherited.opacity);
+            computed.clipPath = style.clipPath;
+            node->m_computedStyle = m_computedStyles.size();
+            m_computedStyles.append(computed);
+        }
+
+        const int index = node->m_computedStyle;
+        switch (node->type()) {
+        case QSvgNode::DOC:
+        case QSvgNode::G:
+        case QSvgNode::DEFS:
+        case QSvgNode::SWITCH:
+        case QSvgNode::MARKER:
+        case QSvgNode::CLIPPATH:
+        case QSvgNode::PATTERN:
+            for (QSvgNode *child : static_cast<QSvgStructureNode *>(node)->renderers())
+                pending.append(qMakePair(child, index));
+            break;
+        case QSvgNode::TEXT:
+        case QSvgNode::TEXTAREA:
+            for (QSvgTspan *tspan : static_cast<QSvgText *>(node)->tspans()) {
+                if (tspan) // line break
+                    pending.append(qMakePair(static_cast<QSvgNode *>(tspan), index));
+            }
+            break;
+        case QSvgNode::TSPAN:
+            for (QSvgTspan *tspan : static_cast<QSvgTspan *>(node)->renderers())
+                pending.append(qMakePair(static_cast<QSvgNode *>(tspan), index));
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void QSvgTinyDocument::setStaticLayersEnabled(bool enabled)
+{
+    m_staticLayersEnabled = enabled;
+    m_staticLayers.clear();
+}
+
+// Drops the cached static layers, for example when a node changes or when
+// nothing redraws the animation for a while.
+void QSvgTinyDocument::releaseStaticLayers()
+{
+    m_staticLayers.clear();
+    if (parent()) {
+        if (QSvgTinyDocument *doc = parent()->document())
+            doc->releaseStaticLayers();
+    }
+}
+
 void QSvgTinyDocument::restartAnimation()
 {
     if (m_animated)
@@ -574,8 +826,9 @@ void QSvgTinyDocument::draw(QPainter *p)
     draw(p, QRectF(), QRectF());
 }
 
-void QSvgTinyDocument::draw(QPainter *p, QSvgExtraStates &)
+void QSvgTinyDocument::draw(QPainter *p, QSvgExtraStates &states)
 {
+    states.painter.flush(p);
     draw(p);
 }
 
@@ -679,13 +932,22 @@ void QSvgTinyDocument::setFramesPerSecond(int num)
 
 void QSvgTinyDocument::appendXmlClass(const QStringList &xmlClasses)
 {
-    for (QString className : xmlClasses) {
-        if (!m_xmlClassList.contains(className))
+    // the handler already hands over distinct classes, usually to an empty list
+    if (m_xmlClassList.isEmpty()) {
+        m_xmlClassList = xmlClasses;
+        return;
+    }
+
+    QSet<QString> known = m_xmlClassList.toSet();
+    for (const QString &className : xmlClasses) {
+        if (!known.contains(className)) {
+            known.insert(className);
             m_xmlClassList.append(className);
+        }
     }
 }
 
-QStringList QSvgTinyDocument::xmlClassList()
+const QStringList &QSvgTinyDocument::xmlClassList() const
 {
     return m_xmlClassList;
 }
@@ -59,6 +59,8 @@
 #include "QtCore/qhash.h"
 #include "QtCore/qdatetime.h"
 #include "QtCore/qxmlstream.h"
+#include "QtCore/qvector.h"
+#include "QtGui/qimage.h"
 #include "qsvgstyle_p.h"
 #include "qsvgfont_p.h"
 
@@ -88,6 +90,7 @@ public:
     QSvgTinyDocument(QSvgNode *parent = nullptr);
     QSvgTinyDocument(const QSvgTinyDocument &other);
     ~QSvgTinyDocument();
+    void setDocument(QSvgTinyDocument *doc) override;
     Type type() const override;
 
     virtual QSvgNode *clone(QSvgNode *parent) override;
@@ -108,11 +111,14 @@ public:
     bool viewBoxValid() const;
     QRectF viewBox() const;
     void setViewBox(const QRectF &rect);
+    void ensureBoundsCached() const;
 
     void draw(QPainter *p, QSvgExtraStates &) override; // from the QSvgNode
 
     void draw(QPainter *p);
     void draw(QPainter *p, const QRectF &bounds, const QRectF &source);
+    void drawAt(QPainter *p, int elapsed, const QRectF &bounds = QRectF(),
+                const QRectF &source = QRectF());
     void draw(QPainter *p, const QString &id, const QRectF &bounds = QRectF());
     void draw(QPainter *p, const QRectF &bounds, const QRectF &source,
               std::function<QPixmap(QPainter*, int, int)> createPixmapBuffer,
@@ -125,13 +131,20 @@ public:
     void addSvgFont(QSvgFont *);
     QSvgFont *svgFont(const QString &family) const;
     void addNamedNode(const QString &id, QSvgNode *node);
+    void adoptNamedNode(QSvgNode *node);
     QSvgNode *namedNode(const QString &id) const;
     void addNamedStyle(const QString &id, QSvgFillStyleProperty *style);
     QSvgFillStyleProperty *namedStyle(const QString &id) const;
 
+    void computeStyles();
+    void clearComputedStyles();
+    const QSvgComputedStyle *computedStyle(int index) const;
+
     const QHash<QString, QSvgRefCounter<QSvgFont>> &namedFonts() const;
     const QHash<QString, QSvgRefCounter<QSvgFillStyleProperty>> &namedStyles() const;
 
+    void setStaticLayersEnabled(bool enabled);
+    void releaseStaticLayers();
     void restartAnimation();
     int currentElapsed() const;
     bool animated() const;
@@ -142,7 +155,7 @@ public:
     void setFramesPerSecond(int num);
 
     void appendXmlClass(const QStringList &xmlClasses);
-    QStringList xmlClassList();
+    const QStringList &xmlClassList() const;
 
     void setSvgProp(const QSharedPointer<QSvgProp> &svgProp);
     QSvgProp *getSvgProp();
@@ -153,20 +166,28 @@ public:
 private:
     void mapSourceToTarget(QPainter *p, const QRectF &targetRect,
                            const QRectF &sourceRect = QRectF());
+    bool canUseStaticLayers(QPainter *p) const;
+    void drawWithStaticLayers(QPainter *p);
+    QImage renderStaticLayer(QPainter *p, int begin, int end, const QSize &size);
 
 private:
     QPointF m_coord;
     QSize m_size;
     bool m_widthPercent;
     bool m_heightPercent;
-    bool m_firstRender;
+    mutable bool m_boundsCached;
     bool m_animated;
 
     mutable QRectF m_viewBox;
 
     QHash<QString, QSvgRefCounter<QSvgFont>> m_fonts;
-    QHash<QString, QSvgNode *> m_namedNodes;
+    // ids map to handles into m_nodeHandles, which a clone only has to
+    // refill with its own nodes
+    QHash<QString, int> m_namedNodes;
+    QVector<QSvgNode *> m_nodeHandles;
+    bool m_adoptingNodes = false;
     QHash<QString, QSvgRefCounter<QSvgFillStyleProperty>> m_namedStyles;
+    QVector<QSvgComputedStyle> m_computedStyles;
 
     QStringList m_xmlClassList;
     QTime m_time;
@@ -177,6 +198,20 @@ private:
     QSharedPointer<QSvgProp> m_svgProp;
     std::function<QPixmap(QPainter*, int, int)> m_createPixmapBufferFun = nullptr;
     std::function<QPixmap(QPainter*, const QImage &img)> m_convertToPixmapFun = nullptr;
+
+    // The top-level nodes without animations in front of the first and
+    // behind the last animated one, rendered once per device size, transform
+    // and render hints and reused for every frame of an animated document.
+    struct StaticLayers
+    {
+        QSize size;
+        QTransform transform;
+        QPainter::RenderHints hints;
+        QImage background;
+        QImage foreground;
+    };
+    bool m_staticLayersEnabled = true;
+    QVector<StaticLayers> m_staticLayers; // most recently used first
 };
 
 inline void QSvgTinyDocument::setCoord(const QPointF &coord)
@@ -274,6 +309,16 @@ inline QSvgProp *QSvgTinyDocument::getSvgProp()
     return m_svgProp.get();
 }
 
+inline void QSvgTinyDocument::clearComputedStyles()
+{
+    m_computedStyles.clear();
+}
+
+inline const QSvgComputedStyle *QSvgTinyDocument::computedStyle(int index) const
+{
+    return uint(index) < uint(m_computedStyles.size()) ? &m_computedStyles.at(index) : nullptr;
+}
+
 QT_END_NAMESPACE
 
 #endif // QSVGTINYDOCUMENT_P_H
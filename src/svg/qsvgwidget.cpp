@@ -84,6 +84,7 @@ class QSvgWidgetPrivate : public QWidgetPrivate
     Q_DECLARE_PUBLIC(QSvgWidget)
 public:
     QSvgRenderer *renderer;
+    bool pausedWhileHidden = false; // the animation was stopped by hideEvent()
 };
 
 /*!
@@ -153,6 +154,33 @@ void QSvgWidget::paintEvent(QPaintEvent *)
     d->renderer->render(&p);
 }
 
+/*!
+    \reimp
+*/
+void QSvgWidget::showEvent(QShowEvent *event)
+{
+    Q_D(QSvgWidget);
+    if (d->pausedWhileHidden) {
+        d->pausedWhileHidden = false;
+        d->renderer->setAnimationActive(true);
+    }
+    QWidget::showEvent(event);
+}
+
+/*!
+    \reimp
+*/
+void QSvgWidget::hideEvent(QHideEvent *event)
+{
+    Q_D(QSvgWidget);
+    // a hidden widget has nothing to repaint
+    if (d->renderer->isAnimationActive()) {
+        d->pausedWhileHidden = true;
+        d->renderer->setAnimationActive(false);
+    }
+    QWidget::hideEvent(event);
+}
+
 /*!
     Loads the contents of the specified SVG \a file and updates the widget.
 */
@@ -12,6 +12,7 @@ HEADERS += \
     qsvghandler_p.h         \
     qsvgimagewriter.h       \
     qsvgnode_p.h            \
+    qsvgnumberformat_p.h    \
     qsvgstructure_p.h       \
     qsvgstyle_p.h           \
     qsvgfont_p.h            \
@@ -26,6 +27,7 @@ SOURCES += \
     qsvghandler.cpp         \
     qsvgimagewriter.cpp     \
     qsvgnode.cpp            \
+    qsvgnumberformat.cpp    \
     qsvgstructure.cpp       \
     qsvgstyle.cpp           \
     qsvgfont.cpp            \
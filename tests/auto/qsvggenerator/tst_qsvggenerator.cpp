@@ -63,6 +63,13 @@ private slots:
     void titleAndDescription();
     void gradientInterpolation();
     void patternBrush();
+    void streaming();
+    void imageDeduplication();
+    void coordinatePrecision();
+    void compactGroups();
+    void compactUserGroups();
+    void gradientReuse();
+    void clipPathReuse();
 
 private:
     QTemporaryDir m_temporaryDir;
@@ -474,6 +481,316 @@ void tst_QSvgGenerator::patternBrush()
         QVERIFY(byteArray.count("<g fill=\"url(#fillpattern") >= 4);
     }
 
+    { // Texture patterns should be reused for the same image and phase
+        QSvgGenerator generator;
+        QByteArray byteArray;
+        QBuffer buffer(&byteArray);
+        generator.setOutputDevice(&buffer);
+        QImage texture(8, 8, QImage::Format_ARGB32);
+        texture.fill(Qt::red);
+        QPainter painter(&generator);
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(QBrush(texture));
+        painter.drawRect(0, 0, 16, 16);
+        painter.drawRect(16, 16, 16, 16);
+        painter.drawRect(4, 0, 16, 16);
+        painter.setBrush(QBrush(texture.copy()));
+        painter.drawRect(32, 32, 16, 16);
+        painter.end();
+
+        QCOMPARE(byteArray.count("<pattern id=\"filltexturepattern"), 2);
+        QCOMPARE(byteArray.count("fill:url(#filltexturepattern"), 4);
+    }
+
+}
+
+void tst_QSvgGenerator::streaming()
+{
+    QByteArray byteArray;
+    QBuffer buffer(&byteArray);
+    QPainter painter;
+
+    {
+        QSvgGenerator generator;
+        QVERIFY(!generator.streamingEnabled());
+        generator.setStreamingEnabled(true);
+        QVERIFY(generator.streamingEnabled());
+        generator.setOutputDevice(&buffer);
+
+        QVERIFY(painter.begin(&generator));
+        drawTestGradients(painter);
+
+        // Everything painted so far is already on the device
+        QVERIFY(byteArray.contains("<linearGradient"));
+        QVERIFY(!byteArray.contains("</svg>"));
+        QVERIFY(byteArray.indexOf("<linearGradient") < byteArray.indexOf("url(#"));
+        painter.end();
+    }
+
+    QVERIFY(byteArray.endsWith("</svg>\n"));
+
+    QImage image(576, 576, QImage::Format_ARGB32_Premultiplied);
+    QImage refImage(576, 576, QImage::Format_ARGB32_Premultiplied);
+    image.fill(0x80208050);
+    refImage.fill(0x80208050);
+
+    {
+        QVERIFY(painter.begin(&image));
+        QSvgRenderer renderer(byteArray);
+        QVERIFY(renderer.isValid());
+        renderer.render(&painter, image.rect());
+        painter.end();
+    }
+
+    {
+        QVERIFY(painter.begin(&refImage));
+        drawTestGradients(painter);
+        painter.end();
+    }
+
+    QVERIFY(sqrImageDiff(image, refImage) < 2);
+}
+
+void tst_QSvgGenerator::imageDeduplication()
+{
+    QImage opaque(16, 16, QImage::Format_RGB32);
+    opaque.fill(Qt::red);
+    QImage translucent(16, 16, QImage::Format_ARGB32);
+    translucent.fill(QColor(0, 0, 255, 128));
+
+    { // Identical images are embedded once and referenced afterwards
+        QSvgGenerator generator;
+        QByteArray byteArray;
+        QBuffer buffer(&byteArray);
+        generator.setOutputDevice(&buffer);
+        QPainter painter(&generator);
+        painter.drawImage(0, 0, opaque);
+        painter.drawImage(QRectF(20, 0, 32, 32), opaque);
+        painter.drawImage(40, 0, opaque.copy());
+        painter.drawImage(80, 0, translucent);
+        painter.end();
+
+        QCOMPARE(byteArray.count("<image id=\"image"), 2);
+        QCOMPARE(byteArray.count("<use xlink:href=\"#image"), 4);
+        QCOMPARE(byteArray.count("data:image/png;base64,"), 2);
+
+        QSvgRenderer renderer(byteArray);
+        QVERIFY(renderer.isValid());
+    }
+
+    { // JPEG is used for opaque images only
+        QSvgGenerator generator;
+        QCOMPARE(generator.imageFormat(), QByteArray("png"));
+        generator.setImageFormat("jpeg");
+        generator.setImageQuality(80);
+        QCOMPARE(generator.imageFormat(), QByteArray("jpeg"));
+        QCOMPARE(generator.imageQuality(), 80);
+        QByteArray byteArray;
+        QBuffer buffer(&byteArray);
+        generator.setOutputDevice(&buffer);
+        QPainter painter(&generator);
+        painter.drawImage(0, 0, opaque);
+        painter.drawImage(20, 0, translucent);
+        painter.end();
+
+        QCOMPARE(byteArray.count("data:image/jpeg;base64,"), 1);
+        QCOMPARE(byteArray.count("data:image/png;base64,"), 1);
+    }
+}
+
+void tst_QSvgGenerator::coordinatePrecision()
+{
+    QPainterPath path;
+    path.moveTo(0.1, 1.0 / 3);
+    path.lineTo(123456.78, -0.000012345);
+    path.lineTo(2.5, 0.30000000000000004);
+
+    const auto generate = [&path](int precision) {
+        QSvgGenerator generator;
+        QByteArray byteArray;
+        QBuffer buffer(&byteArray);
+        generator.setOutputDevice(&buffer);
+        if (precision)
+            generator.setCoordinatePrecision(precision);
+        QPainter painter(&generator);
+        painter.drawPath(path);
+        painter.end();
+        return byteArray;
+    };
+
+    QSvgGenerator generator;
+    QCOMPARE(generator.coordinatePrecision(), 6);
+
+    QVERIFY(generate(0).contains("d=\"M0.1,0.333333 L123457,-1.2345e-05 L2.5,0.3\""));
+    QVERIFY(generate(3).contains("d=\"M0.1,0.333 L1.23e+05,-1.23e-05 L2.5,0.3\""));
+    QVERIFY(generate(QLocale::FloatingPointShortest).contains(
+                "d=\"M0.1,0.3333333333333333 L123456.78,-1.2345e-05 L2.5,0.30000000000000004\""));
+
+    // the shortest form switches notation where QString::number() does
+    path = QPainterPath();
+    path.moveTo(0.0001, 100000);
+    path.lineTo(1000000, 0.00001);
+    path.lineTo(12345678901, 0.00012);
+    QVERIFY(generate(QLocale::FloatingPointShortest).contains(
+                "d=\"M0.0001,100000 L1e+06,1e-05 L12345678901,0.00012\""));
+}
+
+static void drawCompactGroupsTest(QPainter &painter)
+{
+    painter.setPen(Qt::NoPen);
+    for (int i = 0; i < 10; ++i) {
+        painter.save();
+        painter.setBrush(Qt::red);
+        painter.drawRect(i * 10, 0, 8, 8);
+        painter.restore();
+    }
+    painter.setPen(QPen(Qt::blue, 2));
+    painter.translate(10, 20);
+    painter.drawLine(0, 0, 50, 0);
+    painter.setPen(QPen(Qt::blue, 2));
+    painter.drawLine(0, 10, 50, 10);
+}
+
+void tst_QSvgGenerator::compactGroups()
+{
+    QByteArray byteArray;
+    QByteArray compactArray;
+
+    {
+        QBuffer buffer(&byteArray);
+        QSvgGenerator generator;
+        generator.setOutputDevice(&buffer);
+        QPainter painter(&generator);
+        drawCompactGroupsTest(painter);
+    }
+
+    {
+        QBuffer buffer(&compactArray);
+        QSvgGenerator generator;
+        QVERIFY(!generator.compactGroupsEnabled());
+        generator.setCompactGroupsEnabled(true);
+        QVERIFY(generator.compactGroupsEnabled());
+        generator.setOutputDevice(&buffer);
+        QPainter painter(&generator);
+        drawCompactGroupsTest(painter);
+    }
+
+    QVERIFY(compactArray.count("<g ") < byteArray.count("<g "));
+    QVERIFY(compactArray.size() < byteArray.size());
+    QVERIFY(!compactArray.contains("matrix(1,0,0,1,0,0)"));
+    QVERIFY(!compactArray.contains("font-family"));
+    QVERIFY(compactArray.contains("matrix(1,0,0,1,10,20)"));
+
+    QImage image(100, 40, QImage::Format_ARGB32_Premultiplied);
+    QImage compactImage(100, 40, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    compactImage.fill(Qt::white);
+    {
+        QPainter painter(&image);
+        QSvgRenderer(byteArray).render(&painter);
+    }
+    {
+        QPainter painter(&compactImage);
+        QSvgRenderer(compactArray).render(&painter);
+    }
+    QCOMPARE(compactImage, image);
+}
+
+void tst_QSvgGenerator::compactUserGroups()
+{
+    // the defaults left out in compact mode must not inherit from a user group
+    QByteArray byteArrays[2];
+    for (int compact = 0; compact < 2; ++compact) {
+        QBuffer buffer(&byteArrays[compact]);
+        QSvgGenerator generator;
+        generator.setCompactGroupsEnabled(compact);
+        generator.setOutputDevice(&buffer);
+        generator.setSize(QSize(100, 40));
+        generator.setViewBox(QRect(0, 0, 100, 40));
+        QPainter painter(&generator);
+        painter.setPen(QPen(Qt::red, 3));
+        painter.drawLine(0, 5, 100, 5);
+
+        QMap<QString, QString> attrs;
+        attrs.insert(QLatin1String("stroke-width"), QLatin1String("\"9\""));
+        attrs.insert(QLatin1String("stroke-opacity"), QLatin1String("\"0.2\""));
+        generator.beginGroup(&attrs);
+        painter.setPen(QPen(Qt::black, 1));
+        painter.drawLine(0, 20, 100, 20);
+        generator.endGroup();
+
+        painter.setPen(QPen(Qt::blue, 1));
+        painter.drawLine(0, 35, 100, 35);
+    }
+    QVERIFY(byteArrays[1].contains("stroke-width=\"1\""));
+
+    QImage images[2];
+    for (int compact = 0; compact < 2; ++compact) {
+        images[compact] = QImage(100, 40, QImage::Format_ARGB32_Premultiplied);
+        images[compact].fill(Qt::white);
+        QPainter painter(&images[compact]);
+        QSvgRenderer(byteArrays[compact]).render(&painter);
+    }
+    QCOMPARE(images[1], images[0]);
+}
+
+void tst_QSvgGenerator::gradientReuse()
+{
+    QByteArray byteArray;
+    QBuffer buffer(&byteArray);
+    QSvgGenerator generator;
+    generator.setOutputDevice(&buffer);
+
+    QLinearGradient linear(0, 0, 100, 0);
+    linear.setColorAt(0, QColor(255, 0, 0, 0));
+    linear.setColorAt(1, Qt::blue);
+    QRadialGradient radial(50, 50, 50);
+    radial.setColorAt(0, Qt::red);
+    radial.setColorAt(1, Qt::blue);
+
+    QPainter painter(&generator);
+    for (int i = 0; i < 5; ++i) {
+        painter.fillRect(0, i * 10, 100, 10, linear);
+        painter.fillRect(100, i * 10, 100, 10, radial);
+    }
+    linear.setSpread(QGradient::ReflectSpread);
+    painter.fillRect(0, 50, 100, 10, linear);
+    painter.end();
+
+    QCOMPARE(byteArray.count("<linearGradient "), 2);
+    QCOMPARE(byteArray.count("<radialGradient "), 1);
+    QCOMPARE(byteArray.count("fill=\"url(#gradient"), 11);
+}
+
+void tst_QSvgGenerator::clipPathReuse()
+{
+    QByteArray byteArray;
+    QBuffer buffer(&byteArray);
+    QSvgGenerator generator;
+    generator.setClipPathEnabled(true);
+    generator.setOutputDevice(&buffer);
+
+    QPainter painter(&generator);
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            painter.setClipRect(column * 20, row * 10, 20, 10);
+            painter.fillRect(column * 20 - 5, row * 10 - 5, 30, 20, Qt::red);
+            // the same cell again, e.g. for a border
+            painter.setClipRect(column * 20, row * 10, 20, 10);
+            painter.fillRect(column * 20, row * 10, 20, 1, Qt::black);
+        }
+    }
+    QPainterPath ellipse;
+    ellipse.addEllipse(0, 0, 50, 50);
+    painter.setClipPath(ellipse);
+    painter.fillRect(0, 0, 50, 50, Qt::blue);
+    painter.end();
+
+    QCOMPARE(byteArray.count("<clipPath "), 13);
+    QCOMPARE(byteArray.count("<rect x=\"0\" y=\"0\" width=\"20\" height=\"10\"/>\n</clipPath>"), 1);
+
+    QSvgRenderer renderer(byteArray);
+    QVERIFY(renderer.isValid());
 }
 
 QTEST_MAIN(tst_QSvgGenerator)
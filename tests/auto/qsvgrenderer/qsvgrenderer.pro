@@ -1,6 +1,6 @@
 TARGET = tst_qsvgrenderer
 CONFIG += testcase
-QT += svg testlib widgets gui-private
+QT += svg svg-private testlib widgets gui-private
 
 SOURCES += tst_qsvgrenderer.cpp
 RESOURCES += resources.qrc
@@ -33,10 +33,16 @@
 #include <qdebug.h>
 #include <qsvgrenderer.h>
 #include <qsvggenerator.h>
+#include <qsvgwidget.h>
+#include <qgraphicssvgitem.h>
+#include <QGraphicsScene>
 #include <QPainter>
 #include <QPen>
 #include <QPicture>
 #include <QXmlStreamReader>
+#include <QtSvg/private/qsvggraphics_p.h>
+#include <QtSvg/private/qsvgtinydocument_p.h>
+#include <QtSvg/qsvgimagewriter.h>
 
 class tst_QSvgRenderer : public QObject
 {
@@ -61,12 +67,16 @@ private slots:
     void stylePropagation() const;
     void matrixForElement() const;
     void boundsOnElement() const;
+    void strokedBounds() const;
+    void longPathData() const;
     void gradientStops() const;
     void gradientRefs();
     void recursiveRefs_data();
     void recursiveRefs();
     void fillRule();
     void opacity();
+    void shapeOpacity_data();
+    void shapeOpacity();
     void paths();
     void displayMode();
     void strokeInherit();
@@ -75,10 +85,24 @@ private slots:
     void testUseElement();
     void smallFont();
     void styleSheet();
+    void styleSheetSelectors();
+    void styleSheetTypedValues();
+    void sharedStyles();
     void duplicateStyleId();
     void oss_fuzz_23731();
     void oss_fuzz_24131();
     void oss_fuzz_24738();
+    void renderAt();
+    void animationActive();
+    void animationVisibility();
+    void animationThreadChange();
+    void staticLayers();
+    void imageWriterThreads();
+    void cloneNamedNodes();
+    void imageCache();
+    void oversizeImage();
+    void corruptImage();
+    void siblingStateChanges();
 
 #ifndef QT_NO_COMPRESS
     void testGzLoading();
@@ -115,6 +139,14 @@ void tst_QSvgRenderer::getSetCheck()
     QCOMPARE(0, obj1.framesPerSecond()); // Can't have a negative framerate
     obj1.setFramesPerSecond(INT_MAX);
     QCOMPARE(INT_MAX, obj1.framesPerSecond());
+
+    // bool QSvgRenderer::isAnimationActive()
+    // void QSvgRenderer::setAnimationActive(bool)
+    QCOMPARE(true, obj1.isAnimationActive());
+    obj1.setAnimationActive(false);
+    QCOMPARE(false, obj1.isAnimationActive());
+    obj1.setAnimationActive(true);
+    QCOMPARE(true, obj1.isAnimationActive());
 }
 
 void tst_QSvgRenderer::inexistentUrl()
@@ -525,6 +557,54 @@ void tst_QSvgRenderer::boundsOnElement() const
     QCOMPARE(renderer.boundsOnElement(QLatin1String("prim")), QRectF(-10 * sqrt2 - 3, -10 * sqrt2 + 1, 20 * sqrt2, 20 * sqrt2));
 }
 
+void tst_QSvgRenderer::strokedBounds() const
+{
+    // bounds grow by half the stroke width, open ends by sqrt(2) times that
+    QByteArray data("<svg stroke=\"black\" fill=\"none\">"
+                      "<line id=\"line\" x1=\"10\" y1=\"20\" x2=\"110\" y2=\"20\" stroke-width=\"10\"/>"
+                      "<polyline id=\"polyline\" points=\"10,10 60,60 110,10\" stroke-width=\"2\"/>"
+                      "<path id=\"openPath\" d=\"M10 10 L110 10 L110 60\" stroke-width=\"4\"/>"
+                      "<path id=\"closedPath\" d=\"M10 10 L110 10 L110 60 Z\" stroke-width=\"4\"/>"
+                      "<rect id=\"rect\" x=\"10\" y=\"10\" width=\"80\" height=\"40\" stroke-width=\"10\"/>"
+                      "<rect id=\"scaled\" x=\"5\" y=\"5\" width=\"10\" height=\"10\" stroke-width=\"2\""
+                            " transform=\"scale(2,3)\"/>"
+                      "<rect id=\"nonScaling\" x=\"10\" y=\"10\" width=\"80\" height=\"40\" stroke-width=\"10\""
+                            " vector-effect=\"non-scaling-stroke\"/>"
+                    "</svg>");
+
+    const qreal sqrt2 = qSqrt(2);
+    QSvgRenderer renderer(data);
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("line")),
+             QRectF(10 - 5 * sqrt2, 20 - 5 * sqrt2, 100 + 10 * sqrt2, 10 * sqrt2));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("polyline")),
+             QRectF(10 - sqrt2, 10 - sqrt2, 100 + 2 * sqrt2, 50 + 2 * sqrt2));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("openPath")),
+             QRectF(10 - 2 * sqrt2, 10 - 2 * sqrt2, 100 + 4 * sqrt2, 50 + 4 * sqrt2));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("closedPath")), QRectF(8, 8, 104, 54));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("rect")), QRectF(5, 5, 90, 50));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("scaled")), QRectF(8, 12, 24, 36));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("nonScaling")), QRectF(10, 10, 80, 40));
+}
+
+void tst_QSvgRenderer::longPathData() const
+{
+    // long path data is parsed after the tree is built, possibly in parallel
+    QByteArray data("<svg stroke=\"none\">");
+    for (int i = 0; i < 64; ++i) {
+        data += "<path id=\"p" + QByteArray::number(i) + "\" d=\"M0 0";
+        for (int j = 1; j < 200; ++j)
+            data += " L" + QByteArray::number(j) + ' ' + QByteArray::number(j % 2 ? i : 0);
+        data += "\"/>";
+    }
+    data += "</svg>";
+
+    QSvgRenderer renderer(data);
+    QVERIFY(renderer.isValid());
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("p0")), QRectF(0, 0, 199, 0));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("p10")), QRectF(0, 0, 199, 10));
+    QCOMPARE(renderer.boundsOnElement(QLatin1String("p63")), QRectF(0, 0, 199, 63));
+}
+
 void tst_QSvgRenderer::gradientStops() const
 {
     {
@@ -911,6 +991,89 @@ void tst_QSvgRenderer::opacity()
     }
 }
 
+// Images composited through a different path may round differently.
+static bool fuzzyCompareImages(const QImage &a, const QImage &b, int tolerance = 2)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int y = 0; y < a.height(); ++y) {
+        for (int x = 0; x < a.width(); ++x) {
+            const QRgb pa = a.pixel(x, y);
+            const QRgb pb = b.pixel(x, y);
+            if (qAbs(qRed(pa) - qRed(pb)) > tolerance || qAbs(qGreen(pa) - qGreen(pb)) > tolerance
+                || qAbs(qBlue(pa) - qBlue(pb)) > tolerance || qAbs(qAlpha(pa) - qAlpha(pb)) > tolerance)
+                return false;
+        }
+    }
+    return true;
+}
+
+void tst_QSvgRenderer::shapeOpacity_data()
+{
+    QTest::addColumn<QByteArray>("element");
+    QTest::addColumn<QPolygonF>("points");
+    QTest::addColumn<bool>("closed");
+
+    const QPolygonF rect(QRectF(20, 20, 60, 50));
+    QTest::newRow("rect") << QByteArray("<rect x='20' y='20' width='60' height='50'") << rect << true;
+
+    const QPolygonF triangle({ QPointF(20, 80), QPointF(50, 15), QPointF(80, 80) });
+    QTest::newRow("path") << QByteArray("<path d='M20 80 L50 15 L80 80 Z'") << triangle << true;
+    QTest::newRow("polygon") << QByteArray("<polygon points='20 80 50 15 80 80'") << triangle << true;
+    QTest::newRow("polyline") << QByteArray("<polyline points='20 80 50 15 80 80'") << triangle << false;
+}
+
+// The fill and the stroke are composited one after the other, each with its
+// own opacity, whether or not the opacities are equal.
+void tst_QSvgRenderer::shapeOpacity()
+{
+    QFETCH(QByteArray, element);
+    QFETCH(QPolygonF, points);
+    QFETCH(bool, closed);
+
+    QPainterPath shape;
+    shape.addPolygon(points);
+    if (closed)
+        shape.closeSubpath();
+
+    QPen pen(QColor(255, 0, 0), 12, Qt::SolidLine, Qt::FlatCap, Qt::MiterJoin);
+    pen.setMiterLimit(4);
+    const QBrush brush(QColor(0, 0, 255));
+
+    for (int filled = 0; filled < 2; ++filled) {
+        QByteArray svg("<svg width='100' height='100' viewBox='0 0 100 100'>");
+        svg += element;
+        svg += filled ? " fill='#0000ff' fill-opacity='0.5'" : " fill='none'";
+        svg += " stroke='#ff0000' stroke-width='12' stroke-opacity='0.5'/></svg>";
+
+        QImage actual(100, 100, QImage::Format_ARGB32_Premultiplied);
+        actual.fill(Qt::white);
+        QSvgRenderer renderer(svg);
+        QVERIFY(renderer.isValid());
+        QPainter painter(&actual);
+        painter.setRenderHint(QPainter::Antialiasing);
+        renderer.render(&painter);
+        painter.end();
+
+        QImage expected(100, 100, QImage::Format_ARGB32_Premultiplied);
+        expected.fill(Qt::white);
+        painter.begin(&expected);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setOpacity(0.5);
+        if (filled) {
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(brush);
+            painter.drawPath(shape);
+        }
+        painter.setPen(pen);
+        painter.setBrush(Qt::NoBrush);
+        painter.drawPath(shape);
+        painter.end();
+
+        QVERIFY2(fuzzyCompareImages(actual, expected), filled ? "filled" : "unfilled");
+    }
+}
+
 void tst_QSvgRenderer::paths()
 {
     static const char *svgs[] = {
@@ -1513,6 +1676,101 @@ void tst_QSvgRenderer::styleSheet()
     QCOMPARE(images[0], images[1]);
 }
 
+void tst_QSvgRenderer::styleSheetSelectors()
+{
+    static const char *svg =
+        "<svg width=\"40\" height=\"10\">"
+        "<style>#a {fill:#ff0000;} .b {fill:#00ff00;} CIRCLE {fill:#0000ff;}</style>"
+        "<rect id=\"a\" x=\"0\" y=\"0\" width=\"10\" height=\"10\"/>"
+        "<rect class=\"x b\" x=\"10\" y=\"0\" width=\"10\" height=\"10\"/>"
+        "<circle cx=\"25\" cy=\"5\" r=\"5\"/>"
+        "<rect class=\"c\" x=\"30\" y=\"0\" width=\"10\" height=\"10\"/>"
+        "</svg>";
+
+    QSvgRenderer renderer(QByteArray(svg));
+    QVERIFY(renderer.isValid());
+    QImage image(40, 10, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter p(&image);
+    renderer.render(&p);
+    p.end();
+
+    QCOMPARE(image.pixel(5, 5), qRgb(0xff, 0, 0));
+    QCOMPARE(image.pixel(15, 5), qRgb(0, 0xff, 0));
+    QCOMPARE(image.pixel(25, 5), qRgb(0, 0, 0xff));
+    QCOMPARE(image.pixel(35, 5), qRgb(0, 0, 0));
+}
+
+void tst_QSvgRenderer::styleSheetTypedValues()
+{
+    static const char defs[] =
+        "<defs><linearGradient id=\"g\"><stop offset=\"0\" stop-color=\"red\"/>"
+        "<stop offset=\"1\" stop-color=\"blue\"/></linearGradient></defs>";
+    static const char *shapes[] = {
+        "<rect %1 x=\"5\" y=\"5\" width=\"30\" height=\"30\"/>",
+        "<text %1 x=\"5\" y=\"45\">Qt</text>"
+    };
+    static const char *attributes[] = {
+        "fill=\"url(#g)\" stroke=\"url(#g)\" stroke-width=\"4\" fill-opacity=\"0.5\" stroke-opacity=\"0.75\" opacity=\"0.8\"",
+        "fill=\"#008000\" stroke=\"#000080\" stroke-width=\"0.5mm\" font-size=\"20px\" opacity=\"0.5\"",
+        "fill=\"#008000\" font-size=\"150%\""
+    };
+    static const char *styles[] = {
+        "fill:url(#g); stroke:url(#g); stroke-width:4; fill-opacity:0.5; stroke-opacity:0.75; opacity:0.8",
+        "fill:#008000; stroke:#000080; stroke-width:0.5mm; font-size:20px; opacity:0.5",
+        "fill:#008000; font-size:150%"
+    };
+
+    for (int i = 0; i < int(sizeof(styles) / sizeof(styles[0])); ++i) {
+        QImage images[2];
+        for (int css = 0; css < 2; ++css) {
+            QString svg = QLatin1String("<svg width=\"50\" height=\"50\" font-size=\"10\">");
+            if (css)
+                svg += QLatin1String("<style>.s {") + QLatin1String(styles[i]) + QLatin1String(";}</style>");
+            svg += QLatin1String(defs);
+            for (const char *shape : shapes)
+                svg += QString::fromLatin1(shape).arg(QLatin1String(css ? "class=\"s\"" : attributes[i]));
+            svg += QLatin1String("</svg>");
+
+            QSvgRenderer renderer(svg.toUtf8());
+            QVERIFY(renderer.isValid());
+            images[css] = QImage(50, 50, QImage::Format_ARGB32_Premultiplied);
+            images[css].fill(Qt::white);
+            QPainter p(&images[css]);
+            renderer.render(&p);
+        }
+        QVERIFY2(images[0] == images[1], styles[i]);
+    }
+}
+
+void tst_QSvgRenderer::sharedStyles()
+{
+    // identically styled siblings share their fill and stroke, which must
+    // still restore the group's style after each of them is drawn
+    static const char *svg =
+        "<svg width=\"40\" height=\"10\">"
+        "<g fill=\"#0000ff\">"
+        "<rect x=\"0\" y=\"0\" width=\"10\" height=\"10\" fill=\"#ff0000\"/>"
+        "<rect x=\"10\" y=\"0\" width=\"10\" height=\"10\" fill=\"#ff0000\"/>"
+        "<rect x=\"20\" y=\"0\" width=\"10\" height=\"10\"/>"
+        "<rect x=\"30\" y=\"0\" width=\"10\" height=\"10\" fill=\"#ff0000\"/>"
+        "</g>"
+        "</svg>";
+
+    QSvgRenderer renderer(QByteArray(svg));
+    QVERIFY(renderer.isValid());
+    QImage image(40, 10, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter p(&image);
+    renderer.render(&p);
+    p.end();
+
+    QCOMPARE(image.pixel(5, 5), qRgb(0xff, 0, 0));
+    QCOMPARE(image.pixel(15, 5), qRgb(0xff, 0, 0));
+    QCOMPARE(image.pixel(25, 5), qRgb(0, 0, 0xff));
+    QCOMPARE(image.pixel(35, 5), qRgb(0xff, 0, 0));
+}
+
 void tst_QSvgRenderer::duplicateStyleId()
 {
     QByteArray svg = QByteArrayLiteral("<svg><linearGradient id=\"a\"/>"
@@ -1550,5 +1808,518 @@ void tst_QSvgRenderer::oss_fuzz_24738()
     QSvgRenderer().load(QByteArray("<svg><path d=\"a 2 1e-212.....\">"));
 }
 
+void tst_QSvgRenderer::renderAt()
+{
+    QByteArray svg("<svg width='100' height='20' viewBox='0 0 100 20'>"
+                   "<rect x='0' y='0' width='20' height='20' fill='#ff0000'>"
+                   "<animateTransform attributeName='transform' type='translate'"
+                   " from='0 0' to='80 0' dur='1s' repeatCount='indefinite'/>"
+                   "</rect></svg>");
+    QSvgRenderer renderer(svg);
+    QVERIFY(renderer.animated());
+
+    auto frameAt = [&renderer](qint64 timeMs) {
+        QImage image(100, 20, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        renderer.renderAt(&painter, timeMs);
+        painter.end();
+        return image;
+    };
+
+    const QImage half = frameAt(500);
+    QCOMPARE(half.pixel(50, 10), qRgb(255, 0, 0));
+    QCOMPARE(half.pixel(10, 10), qRgb(255, 255, 255));
+
+    // Frames don't depend on what was rendered before.
+    frameAt(900);
+    QCOMPARE(frameAt(500), half);
+    QVERIFY(frameAt(0) != half);
+}
+
+void tst_QSvgRenderer::animationActive()
+{
+    QByteArray svg("<svg width='10' height='10'><rect width='10' height='10'>"
+                   "<animateTransform attributeName='transform' type='rotate'"
+                   " from='0' to='360' dur='1s' repeatCount='indefinite'/>"
+                   "</rect></svg>");
+    QSvgRenderer first(svg);
+    QSvgRenderer second(svg);
+    first.setFramesPerSecond(50);
+    second.setFramesPerSecond(50);
+    first.load(svg);
+    second.load(svg);
+
+    QSignalSpy firstSpy(&first, SIGNAL(repaintNeeded()));
+    QSignalSpy secondSpy(&second, SIGNAL(repaintNeeded()));
+    QTRY_VERIFY(firstSpy.count() >= 2);
+    QTRY_VERIFY(secondSpy.count() >= 2);
+
+    first.setAnimationActive(false);
+    firstSpy.clear();
+    secondSpy.clear();
+    QTRY_VERIFY(secondSpy.count() >= 2);
+    QCOMPARE(firstSpy.count(), 0);
+
+    first.setAnimationActive(true);
+    QTRY_VERIFY(firstSpy.count() >= 2);
+}
+
+void tst_QSvgRenderer::animationVisibility()
+{
+    QByteArray svg("<svg width='10' height='10'><rect width='10' height='10'>"
+                   "<animateTransform attributeName='transform' type='rotate'"
+                   " from='0' to='360' dur='1s' repeatCount='indefinite'/>"
+                   "</rect></svg>");
+
+    QSvgWidget widget;
+    widget.load(svg);
+    widget.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&widget));
+    QVERIFY(widget.renderer()->isAnimationActive());
+    widget.hide();
+    QVERIFY(!widget.renderer()->isAnimationActive());
+    widget.show();
+    QVERIFY(widget.renderer()->isAnimationActive());
+
+    // an animation paused by the application stays paused
+    widget.renderer()->setAnimationActive(false);
+    widget.hide();
+    widget.show();
+    QVERIFY(!widget.renderer()->isAnimationActive());
+
+    QGraphicsSvgItem *item = new QGraphicsSvgItem;
+    item->renderer()->load(svg);
+    QVERIFY(!item->renderer()->isAnimationActive());
+    QGraphicsScene scene;
+    scene.addItem(item);
+    QVERIFY(item->renderer()->isAnimationActive());
+    item->hide();
+    QVERIFY(!item->renderer()->isAnimationActive());
+    item->show();
+    QVERIFY(item->renderer()->isAnimationActive());
+    scene.removeItem(item);
+    QVERIFY(!item->renderer()->isAnimationActive());
+    delete item;
+}
+
+void tst_QSvgRenderer::animationThreadChange()
+{
+    QByteArray svg("<svg width='10' height='10'><rect width='10' height='10'>"
+                   "<animateTransform attributeName='transform' type='rotate'"
+                   " from='0' to='360' dur='1s' repeatCount='indefinite'/>"
+                   "</rect></svg>");
+    QThread thread;
+    thread.start();
+
+    QSvgRenderer *renderer = new QSvgRenderer(svg);
+    renderer->setFramesPerSecond(50);
+    QAtomicPointer<QThread> tickThread;
+    connect(renderer, &QSvgRenderer::repaintNeeded, renderer,
+            [&tickThread] { tickThread.store(QThread::currentThread()); }, Qt::DirectConnection);
+    renderer->moveToThread(&thread);
+
+    // the renderer ticks in the thread it was moved to
+    QTRY_COMPARE(tickThread.load(), &thread);
+    QTest::qWait(100);
+    QCOMPARE(tickThread.load(), &thread);
+
+    QMetaObject::invokeMethod(renderer, [renderer] { delete renderer; }, Qt::BlockingQueuedConnection);
+    thread.quit();
+    QVERIFY(thread.wait());
+}
+
+void tst_QSvgRenderer::staticLayers()
+{
+    // static content in front of, between and behind the animated nodes
+    QByteArray svg("<svg width='100' height='40' viewBox='0 0 100 40'>"
+                   "<rect id='back' width='100' height='40' fill='#0000ff'/>"
+                   "<rect x='0' y='0' width='20' height='20' fill='#ff0000' opacity='0.5'>"
+                   "<animateTransform attributeName='transform' type='translate'"
+                   " from='0 0' to='80 0' dur='1s' repeatCount='indefinite'/>"
+                   "</rect>"
+                   "<circle id='middle' cx='50' cy='10' r='8' fill='#00ff00'/>"
+                   "<rect x='0' y='20' width='20' height='20' fill='#ffff00'>"
+                   "<animateTransform attributeName='transform' type='translate'"
+                   " from='80 0' to='0 0' dur='1s' repeatCount='indefinite'/>"
+                   "</rect>"
+                   "<ellipse id='front' cx='50' cy='30' rx='30' ry='6' fill='#ffffff' fill-opacity='0.5'/>"
+                   "</svg>");
+    QScopedPointer<QSvgTinyDocument> layered(QSvgTinyDocument::load(svg));
+    QScopedPointer<QSvgTinyDocument> direct(QSvgTinyDocument::load(svg));
+    QVERIFY(layered);
+    QVERIFY(direct);
+    QVERIFY(layered->animated());
+    direct->setStaticLayersEnabled(false);
+
+    auto frameAt = [](QSvgTinyDocument *doc, int elapsed, const QSize &size, bool antialiased) {
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing, antialiased);
+        doc->drawAt(&painter, elapsed, QRectF(QPointF(0, 0), size));
+        painter.end();
+        return image;
+    };
+
+    const QSize small(100, 40);
+    const QSize large(200, 80);
+    for (int elapsed : { 0, 250, 500, 750 }) {
+        QVERIFY(fuzzyCompareImages(frameAt(layered.data(), elapsed, small, true), frameAt(direct.data(), elapsed, small, true)));
+        QVERIFY(fuzzyCompareImages(frameAt(layered.data(), elapsed, large, true), frameAt(direct.data(), elapsed, large, true)));
+    }
+
+    // changing the nodes or the render hints doesn't reuse stale layers
+    for (const char *id : { "back", "middle", "front" }) {
+        layered->namedNode(QLatin1String(id))->setVisible(false);
+        direct->namedNode(QLatin1String(id))->setVisible(false);
+        QVERIFY(fuzzyCompareImages(frameAt(layered.data(), 500, small, true), frameAt(direct.data(), 500, small, true)));
+    }
+    layered->namedNode(QLatin1String("back"))->setVisible(true);
+    direct->namedNode(QLatin1String("back"))->setVisible(true);
+    QVERIFY(fuzzyCompareImages(frameAt(layered.data(), 500, small, false), frameAt(direct.data(), 500, small, false)));
+    QVERIFY(fuzzyCompareImages(frameAt(layered.data(), 500, small, true), frameAt(direct.data(), 500, small, true)));
+}
+
+void tst_QSvgRenderer::imageWriterThreads()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QImage pixels(16, 16, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < pixels.height(); ++y) {
+        for (int x = 0; x < pixels.width(); ++x)
+            pixels.setPixel(x, y, qRgb(x * 16, y * 16, 128));
+    }
+    const QString imagePath = dir.filePath(QLatin1String("pixels.png"));
+    QVERIFY(pixels.save(imagePath));
+
+    // groups large enough to be written on the thread pool, each with
+    // images that have to be encoded
+    QByteArray svg("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink'"
+                   " width='200' height='200'>");
+    for (int group = 0; group < 6; ++group) {
+        svg += "<g id='g" + QByteArray::number(group) + "' fill='#00ff00'>";
+        for (int i = 0; i < 80; ++i) {
+            svg += "<rect x='" + QByteArray::number(i) + "' y='" + QByteArray::number(group * 10)
+                    + "' width='1.5' height='2.25'/>";
+            if (i % 20 == 0) {
+                svg += "<image x='" + QByteArray::number(i) + "' y='0' width='16' height='16'"
+                        " xlink:href='" + imagePath.toUtf8() + "'/>";
+            }
+        }
+        svg += "</g>";
+    }
+    svg += "<image id='last' width='16' height='16' xlink:href='" + imagePath.toUtf8() + "'/>";
+    svg += "</svg>";
+    QScopedPointer<QSvgTinyDocument> doc(QSvgTinyDocument::load(svg));
+    QVERIFY(doc);
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int maxThreads = pool->maxThreadCount();
+
+    pool->setMaxThreadCount(1);
+    QByteArray serial;
+    const bool serialWritten = QSvgImageWriter(doc.data(), &serial).write();
+
+    pool->setMaxThreadCount(qMax(4, maxThreads));
+    QByteArray parallel;
+    const bool parallelWritten = QSvgImageWriter(doc.data(), &parallel).write();
+
+    pool->setMaxThreadCount(maxThreads);
+
+    QVERIFY(serialWritten);
+    QVERIFY(parallelWritten);
+    QVERIFY(serial.contains("data:image/png;base64,"));
+    QCOMPARE(parallel, serial);
+
+    QScopedPointer<QSvgTinyDocument> reloaded(QSvgTinyDocument::load(parallel));
+    QVERIFY(reloaded);
+    QVERIFY(reloaded->elementExists(QLatin1String("g5")));
+    QVERIFY(reloaded->elementExists(QLatin1String("last")));
+}
+
+static QByteArray pngPayload(int width, int height)
+{
+    QImage pixels(width, height, QImage::Format_RGB32);
+    pixels.fill(qRgb(width % 256, height % 256, 128));
+    pixels.setPixel(0, 0, qRgb(255, 0, 0));
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    pixels.save(&buffer, "PNG");
+    return data;
+}
+
+static QByteArray imageElement(const QByteArray &id, const QByteArray &payload)
+{
+    return "<image id='" + id + "' width='16' height='16'"
+           " xlink:href='data:image/png;base64," + payload.toBase64() + "'/>";
+}
+
+static const QSvgImage *imageNode(const QSvgTinyDocument *doc, const char *id)
+{
+    const QSvgNode *node = doc->namedNode(QLatin1String(id));
+    if (!node || node->type() != QSvgNode::IMAGE)
+        return nullptr;
+    return static_cast<const QSvgImage *>(node);
+}
+
+void tst_QSvgRenderer::cloneNamedNodes()
+{
+    QByteArray svg("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink'"
+                   " width='100' height='100'>"
+                   "<defs>"
+                   "<marker id='marker' markerWidth='4' markerHeight='4'><circle id='inMarker' r='2'/></marker>"
+                   "<clipPath id='clip'><rect id='inClip' width='50' height='50'/></clipPath>"
+                   "<pattern id='pattern' width='10' height='10' patternUnits='userSpaceOnUse'>"
+                   "<rect id='inPattern' width='5' height='5'/></pattern>"
+                   "</defs>"
+                   "<g id='outer'><g id='inner'><rect id='inGroup' width='10' height='10'"
+                   " fill='url(#pattern)' clip-path='url(#clip)'/></g></g>"
+                   "<path id='top' d='M0 0 L10 10' stroke='black' marker-end='url(#marker)'/>"
+                   "</svg>");
+    QScopedPointer<QSvgTinyDocument> original(QSvgTinyDocument::load(svg));
+    QVERIFY(original);
+
+    const QStringList ids = { QStringLiteral("marker"), QStringLiteral("inMarker"),
+                              QStringLiteral("clip"), QStringLiteral("inClip"),
+                              QStringLiteral("pattern"), QStringLiteral("inPattern"),
+                              QStringLiteral("outer"), QStringLiteral("inner"),
+                              QStringLiteral("inGroup"), QStringLiteral("top") };
+    QHash<QString, const QSvgNode *> originalNodes;
+    for (const QString &id : ids) {
+        const QSvgNode *node = original->namedNode(id);
+        QVERIFY2(node, qPrintable(id));
+        originalNodes.insert(id, node);
+    }
+
+    QScopedPointer<QSvgTinyDocument> clone(new QSvgTinyDocument(*original));
+    for (const QString &id : ids) {
+        QVERIFY2(clone->elementExists(id), qPrintable(id));
+        const QSvgNode *node = clone->namedNode(id);
+        QVERIFY2(node, qPrintable(id));
+        QVERIFY2(node != originalNodes.value(id), qPrintable(id));
+        QCOMPARE(node->nodeId(), id);
+        QCOMPARE(node->document(), clone.data());
+        const QSvgNode *root = node;
+        while (root->parent())
+            root = root->parent();
+        QCOMPARE(root, static_cast<const QSvgNode *>(clone.data()));
+    }
+    QVERIFY(!clone->elementExists(QStringLiteral("missing")));
+
+    // the clone's index doesn't depend on the original
+    original.reset();
+    for (const QString &id : ids)
+        QCOMPARE(clone->namedNode(id)->nodeId(), id);
+}
+
+void tst_QSvgRenderer::imageCache()
+{
+    // 16 MB each once decoded, so four of them fill the cache
+    const QByteArray large = pngPayload(2048, 2048);
+    QByteArray svg("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink'"
+                   " width='100' height='100'><defs>");
+    for (int i = 0; i < 5; ++i)
+        svg += imageElement("large" + QByteArray::number(i), large);
+    svg += imageElement("small", pngPayload(8, 4));
+    svg += "</defs></svg>";
+    QScopedPointer<QSvgTinyDocument> doc(QSvgTinyDocument::load(svg));
+    QVERIFY(doc);
+
+    // loading only reads the headers
+    for (int i = 0; i < 5; ++i) {
+        const QSvgImage *node = imageNode(doc.data(), QByteArray("large" + QByteArray::number(i)).constData());
+        QVERIFY(node);
+        QCOMPARE(node->imageSize(), QSize(2048, 2048));
+        QVERIFY(!node->isDecoded());
+    }
+    const QSvgImage *small = imageNode(doc.data(), "small");
+    QVERIFY(small);
+    QVERIFY(!small->isDecoded());
+    QCOMPARE(small->encodedData(), pngPayload(8, 4));
+    QCOMPARE(small->mimeType(), QLatin1String("image/png"));
+    QCOMPARE(small->imageSize(), QSize(8, 4));
+
+    // the pixels are decoded on first use and then reused
+    QImage pixels = small->image();
+    QVERIFY(small->isDecoded());
+    QCOMPARE(pixels.size(), QSize(8, 4));
+    QCOMPARE(pixels.pixel(0, 0), qRgb(255, 0, 0));
+    QCOMPARE(pixels.pixel(1, 0), qRgb(8, 4, 128));
+    QCOMPARE(small->image().cacheKey(), pixels.cacheKey());
+
+    // using the other large images evicts the least recently used one
+    const QSvgImage *first = imageNode(doc.data(), "large0");
+    QVERIFY(first);
+    const qint64 firstKey = first->image().cacheKey();
+    QCOMPARE(first->image().cacheKey(), firstKey);
+    for (int i = 1; i < 5; ++i) {
+        const QSvgImage *node = imageNode(doc.data(), QByteArray("large" + QByteArray::number(i)).constData());
+        QVERIFY(node);
+        QCOMPARE(node->image().size(), QSize(2048, 2048));
+    }
+    QVERIFY(!first->isDecoded());
+    pixels = first->image();
+    QVERIFY(pixels.cacheKey() != firstKey);
+    QCOMPARE(pixels.size(), QSize(2048, 2048));
+    QCOMPARE(pixels.pixel(0, 0), qRgb(255, 0, 0));
+
+    // a clone keeps its image when the original goes away
+    QSvgTinyDocument *clone = new QSvgTinyDocument(*doc);
+    doc.reset(clone);
+    QCOMPARE(imageNode(clone, "small")->image().pixel(0, 0), qRgb(255, 0, 0));
+}
+
+void tst_QSvgRenderer::oversizeImage()
+{
+    // larger than the whole image cache once decoded
+    QByteArray svg("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink'"
+                   " width='100' height='100'>");
+    svg += imageElement("huge", pngPayload(4400, 4400));
+    svg += imageElement("small", pngPayload(8, 4));
+    svg += "</svg>";
+    QScopedPointer<QSvgTinyDocument> doc(QSvgTinyDocument::load(svg));
+    QVERIFY(doc);
+
+    const QSvgImage *huge = imageNode(doc.data(), "huge");
+    QVERIFY(huge);
+    const QImage pixels = huge->image();
+    QCOMPARE(pixels.size(), QSize(4400, 4400));
+    QCOMPARE(pixels.pixel(0, 0), qRgb(255, 0, 0));
+    // not decoded again for every use
+    QCOMPARE(huge->image().cacheKey(), pixels.cacheKey());
+
+    // but it leaves the cache for the next image
+    const QSvgImage *small = imageNode(doc.data(), "small");
+    QVERIFY(small);
+    QCOMPARE(small->image().size(), QSize(8, 4));
+    QVERIFY(!huge->isDecoded());
+    QVERIFY(small->isDecoded());
+}
+
+void tst_QSvgRenderer::corruptImage()
+{
+    // a valid PNG signature and header followed by garbage
+    QByteArray payload = pngPayload(16, 16).left(33);
+    payload += QByteArray(64, 'x');
+
+    QByteArray svg("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink'"
+                   " width='100' height='100'>");
+    svg += imageElement("unreadable", QByteArray(64, 'x'));
+    svg += imageElement("corrupt", payload);
+    svg += imageElement("valid", pngPayload(16, 16));
+    svg += "</svg>";
+
+    // a payload without a readable header is rejected while loading
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Could not create image from"));
+    QScopedPointer<QSvgTinyDocument> doc(QSvgTinyDocument::load(svg));
+    QVERIFY(doc);
+    QVERIFY(!doc->elementExists(QLatin1String("unreadable")));
+    QVERIFY(imageNode(doc.data(), "valid"));
+
+    // the rest of the payload is only checked when it is decoded, once
+    const QSvgImage *corrupt = imageNode(doc.data(), "corrupt");
+    QVERIFY(corrupt);
+    QCOMPARE(corrupt->imageSize(), QSize(16, 16));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("could not decode the embedded image/png image"));
+    QVERIFY(corrupt->image().isNull());
+    QVERIFY(corrupt->image().isNull());
+    QVERIFY(!corrupt->isDecoded());
+}
+
+struct StateChanges
+{
+    int pen = 0;
+    int brush = 0;
+    int font = 0;
+};
+
+// Counts the draw calls that see a changed pen, brush or font.
+class StateCountingEngine : public QPaintEngine
+{
+public:
+    StateCountingEngine() : QPaintEngine(AllFeatures) {}
+
+    bool begin(QPaintDevice *) override { return true; }
+    bool end() override { return true; }
+    void updateState(const QPaintEngineState &state) override
+    {
+        if (state.state() & DirtyPen)
+            ++changes.pen;
+        if (state.state() & DirtyBrush)
+            ++changes.brush;
+        if (state.state() & DirtyFont)
+            ++changes.font;
+    }
+    void drawRects(const QRectF *, int) override {}
+    void drawPath(const QPainterPath &) override {}
+    void drawPolygon(const QPointF *, int, PolygonDrawMode) override {}
+    void drawPixmap(const QRectF &, const QPixmap &, const QRectF &) override {}
+    Type type() const override { return User; }
+
+    StateChanges changes;
+};
+
+class StateCountingDevice : public QPaintDevice
+{
+public:
+    QPaintEngine *paintEngine() const override { return &engine; }
+
+    mutable StateCountingEngine engine;
+
+protected:
+    int metric(PaintDeviceMetric m) const override
+    {
+        switch (m) {
+        case PdmWidth:
+        case PdmHeight:
+            return 100;
+        case PdmWidthMM:
+        case PdmHeightMM:
+            return 26;
+        case PdmDpiX:
+        case PdmDpiY:
+        case PdmPhysicalDpiX:
+        case PdmPhysicalDpiY:
+            return 96;
+        case PdmDepth:
+            return 32;
+        default:
+            return QPaintDevice::metric(m);
+        }
+    }
+};
+
+static void countStateChanges(int rects, StateChanges *changes)
+{
+    QByteArray svg("<svg width='100' height='100'><g font-size='20'>");
+    for (int i = 0; i < rects; ++i)
+        svg += "<rect x='" + QByteArray::number(i * 20) + "' width='10' height='10' fill='#ff0000' stroke='#0000ff'/>";
+    svg += "</g></svg>";
+    QSvgRenderer renderer(svg);
+    QVERIFY(renderer.isValid());
+
+    StateCountingDevice device;
+    QPainter p(&device);
+    renderer.render(&p);
+    p.end();
+    *changes = device.engine.changes;
+}
+
+void tst_QSvgRenderer::siblingStateChanges()
+{
+    StateChanges one;
+    countStateChanges(1, &one);
+    StateChanges three;
+    countStateChanges(3, &three);
+
+    // the first rect sets up the painter, its siblings draw with it as it is
+    QVERIFY(one.brush > 0);
+    QCOMPARE(three.pen, one.pen);
+    QCOMPARE(three.brush, one.brush);
+    QCOMPARE(three.font, one.font);
+}
+
 QTEST_MAIN(tst_QSvgRenderer)
 #include "tst_qsvgrenderer.moc"